@@ -0,0 +1,326 @@
+// Нагрузочный тест: воспроизводит журнал запросов против одного общего SearchServer
+// из нескольких потоков и выводит в stdout JSON с пропускной способностью,
+// p50/p99/p999 задержки и пиковым потреблением памяти.
+// Сборка из каталога search-server:
+// g++ -std=c++17 -O2 -DNDEBUG -I. benchmarks/load_generator.cpp $(ls *.cpp | grep -v '^main.cpp$') -o load_generator -ltbb -lpthread
+// Запуск: ./load_generator --documents=docs.txt --queries=queries.txt --threads=8 --qps=2000 --duration-s=30 --write-ratio=0.01
+// Файлы - по документу или запросу на строку, стоп-слова файлового корпуса задаются --stop-words="a b".
+// Без файлов используется синтетический корпус benchmarks/synthetic_corpus.h:
+// --synthetic-documents=N, --synthetic-queries=N
+
+#include "benchmarks/synthetic_corpus.h"
+#include "process_queries.h"
+#include "query_metrics.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct LoadOptions {
+    string documents_path;
+    string queries_path;
+    string stop_words;
+    size_t synthetic_document_count = 100'000;
+    size_t synthetic_query_count = 10'000;
+    size_t thread_count = max(1u, thread::hardware_concurrency());
+    // обращений к серверу в секунду, пакет ProcessQueries - одно обращение.
+    // 0 - замкнутый цикл: каждый поток отправляет запрос сразу после ответа
+    double target_qps = 0.0;
+    chrono::milliseconds duration{ 10'000 };
+    // запросов в одном вызове ProcessQueries; 1 - отдельные FindTopDocuments
+    size_t batch_size = 1;
+    // доля операций записи: AddDocument и RemoveDocument по очереди
+    double write_ratio = 0.0;
+    uint64_t seed = 42;
+};
+
+struct LoadStats {
+    DurationHistogram read_latency;
+    DurationHistogram write_latency;
+    atomic<uint64_t> queries{ 0 };
+    atomic<uint64_t> errors{ 0 };
+};
+
+vector<string> ReadLines(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw invalid_argument("Cannot open "s + path);
+    }
+    vector<string> lines;
+    for (string line; getline(input, line);) {
+        if (!line.empty()) {
+            lines.push_back(move(line));
+        }
+    }
+    return lines;
+}
+
+// Пиковый объём резидентной памяти процесса в килобайтах; 0, если неизвестен
+long GetMemoryHighWaterKb() {
+#ifndef _WIN32
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+class LoadGenerator {
+public:
+    LoadGenerator(const LoadOptions& options, SearchServer& search_server, vector<string> documents, vector<string> queries)
+        : options_(options)
+        , search_server_(search_server)
+        , documents_(move(documents))
+        , queries_(move(queries))
+        , next_document_id_(static_cast<int>(documents_.size())) {
+        if (queries_.empty()) {
+            throw invalid_argument("Query log is empty");
+        }
+        if (options_.thread_count == 0 || options_.batch_size == 0) {
+            throw invalid_argument("Thread count and batch size must be positive");
+        }
+    }
+
+    void Run() {
+        start_time_ = Clock::now();
+        deadline_ = start_time_ + options_.duration;
+        vector<thread> threads;
+        for (size_t thread_index = 0; thread_index < options_.thread_count; ++thread_index) {
+            threads.emplace_back([this, thread_index] {
+                RunThread(thread_index);
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        finish_time_ = Clock::now();
+    }
+
+    void PrintJson(ostream& output) const {
+        const double seconds = chrono::duration<double>(finish_time_ - start_time_).count();
+        const auto print_latency = [&output](const DurationHistogram& histogram) {
+            output << "{\"count\": " << histogram.GetCount()
+                   << ", \"p50_ns\": " << histogram.GetQuantile(0.5)
+                   << ", \"p99_ns\": " << histogram.GetQuantile(0.99)
+                   << ", \"p999_ns\": " << histogram.GetQuantile(0.999)
+                   << ", \"max_ns\": " << histogram.GetQuantile(1.0) << '}';
+        };
+        output << "{\n  \"mode\": \"" << (options_.target_qps > 0.0 ? "open" : "closed") << '"'
+               << ",\n  \"threads\": " << options_.thread_count
+               << ",\n  \"target_qps\": " << options_.target_qps
+               << ",\n  \"batch_size\": " << options_.batch_size
+               << ",\n  \"write_ratio\": " << options_.write_ratio
+               << ",\n  \"documents\": " << documents_.size()
+               << ",\n  \"seconds\": " << seconds
+               << ",\n  \"queries\": " << stats_.queries.load()
+               << ",\n  \"errors\": " << stats_.errors.load()
+               << ",\n  \"throughput_qps\": " << stats_.queries.load() / seconds
+               << ",\n  \"read_latency\": ";
+        print_latency(stats_.read_latency);
+        output << ",\n  \"write_latency\": ";
+        print_latency(stats_.write_latency);
+        output << ",\n  \"memory_high_water_kb\": " << GetMemoryHighWaterKb() << "\n}" << endl;
+    }
+
+private:
+    const LoadOptions& options_;
+    SearchServer& search_server_;
+    const vector<string> documents_;
+    const vector<string> queries_;
+    // SearchServer не допускает изменений одновременно с поиском
+    shared_mutex server_mutex_;
+    LoadStats stats_;
+
+    atomic<uint64_t> next_request_{ 0 };
+    atomic<int> next_document_id_;
+    mutex added_ids_mutex_;
+    vector<int> added_ids_;
+
+    Clock::time_point start_time_;
+    Clock::time_point deadline_;
+    Clock::time_point finish_time_;
+
+    void RunThread(size_t thread_index) {
+        mt19937_64 generator(options_.seed + thread_index);
+        uniform_real_distribution<double> probability(0.0, 1.0);
+        vector<string> batch;
+        while (true) {
+            const uint64_t request = next_request_.fetch_add(1, memory_order_relaxed);
+            // в открытом режиме запрос назначается на своё время, и задержка считается от него,
+            // поэтому очередь к перегруженному серверу входит в задержку
+            Clock::time_point start = Clock::now();
+            if (options_.target_qps > 0.0) {
+                const Clock::time_point scheduled = start_time_
+                    + chrono::duration_cast<Clock::duration>(chrono::duration<double>(request / options_.target_qps));
+                if (scheduled >= deadline_) {
+                    return;
+                }
+                this_thread::sleep_until(scheduled);
+                start = scheduled;
+            } else if (start >= deadline_) {
+                return;
+            }
+
+            if (options_.write_ratio > 0.0 && probability(generator) < options_.write_ratio) {
+                Write(request);
+                stats_.write_latency.Record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+                continue;
+            }
+
+            try {
+                shared_lock lock(server_mutex_);
+                if (options_.batch_size == 1) {
+                    search_server_.FindTopDocuments(queries_[request % queries_.size()]);
+                } else {
+                    batch.clear();
+                    for (size_t i = 0; i < options_.batch_size; ++i) {
+                        batch.push_back(queries_[(request * options_.batch_size + i) % queries_.size()]);
+                    }
+                    ProcessQueries(search_server_, batch);
+                }
+            } catch (const exception&) {
+                stats_.errors.fetch_add(1, memory_order_relaxed);
+            }
+            stats_.read_latency.Record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+            stats_.queries.fetch_add(options_.batch_size, memory_order_relaxed);
+        }
+    }
+
+    // Нечётные записи удаляют добавленный ранее документ, чётные добавляют новый
+    void Write(uint64_t request) {
+        int removed_id = -1;
+        if (request % 2 == 1) {
+            lock_guard lock(added_ids_mutex_);
+            if (!added_ids_.empty()) {
+                removed_id = added_ids_.back();
+                added_ids_.pop_back();
+            }
+        }
+        unique_lock lock(server_mutex_);
+        if (removed_id >= 0) {
+            search_server_.RemoveDocument(removed_id);
+            return;
+        }
+        const int document_id = next_document_id_++;
+        const string& document = documents_.empty() ? queries_[request % queries_.size()] : documents_[request % documents_.size()];
+        try {
+            search_server_.AddDocument(document_id, document, DocumentStatus::ACTUAL, { 0 });
+        } catch (const exception&) {
+            stats_.errors.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        lock.unlock();
+        lock_guard ids_lock(added_ids_mutex_);
+        added_ids_.push_back(document_id);
+    }
+};
+
+LoadOptions ParseOptions(int argc, char** argv) {
+    LoadOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t equals = argument.find('=');
+        if (argument.substr(0, 2) != "--" || equals == argument.npos) {
+            throw invalid_argument("Expected --name=value, got "s + string(argument));
+        }
+        const string_view name = argument.substr(2, equals - 2);
+        const string value(argument.substr(equals + 1));
+        if (name == "documents") {
+            options.documents_path = value;
+        } else if (name == "queries") {
+            options.queries_path = value;
+        } else if (name == "stop-words") {
+            options.stop_words = value;
+        } else if (name == "synthetic-documents") {
+            options.synthetic_document_count = stoull(value);
+        } else if (name == "synthetic-queries") {
+            options.synthetic_query_count = stoull(value);
+        } else if (name == "threads") {
+            options.thread_count = stoull(value);
+        } else if (name == "qps") {
+            options.target_qps = stod(value);
+        } else if (name == "duration-s") {
+            options.duration = chrono::milliseconds(static_cast<int64_t>(stod(value) * 1000));
+        } else if (name == "batch") {
+            options.batch_size = stoull(value);
+        } else if (name == "write-ratio") {
+            options.write_ratio = stod(value);
+        } else if (name == "seed") {
+            options.seed = stoull(value);
+        } else {
+            throw invalid_argument("Unknown option --"s + string(name));
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const LoadOptions options = ParseOptions(argc, argv);
+        CorpusOptions corpus_options;
+        corpus_options.seed = options.seed;
+        SyntheticCorpus corpus(corpus_options);
+
+        vector<string> documents;
+        if (!options.documents_path.empty()) {
+            documents = ReadLines(options.documents_path);
+        } else {
+            documents.resize(options.synthetic_document_count);
+            for (string& document : documents) {
+                document = corpus.GenerateDocument();
+            }
+        }
+        vector<string> queries;
+        if (!options.queries_path.empty()) {
+            queries = ReadLines(options.queries_path);
+        } else {
+            queries.resize(options.synthetic_query_count);
+            for (string& query : queries) {
+                query = corpus.GenerateQuery();
+            }
+        }
+
+        SearchServer search_server(options.documents_path.empty() ? corpus.GetStopWords() : options.stop_words);
+        {
+            LOG_DURATION("Indexing"s);
+            for (size_t id = 0; id < documents.size(); ++id) {
+                search_server.AddDocument(static_cast<int>(id), documents[id], DocumentStatus::ACTUAL, { 0 });
+            }
+        }
+
+        LoadGenerator generator(options, search_server, move(documents), move(queries));
+        generator.Run();
+        generator.PrintJson(cout);
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,268 @@
+// Бенчмарки основных операций SearchServer на синтетическом корпусе.
+// Результаты выводятся в stdout в JSON, чтобы сравнивать прогоны разных версий.
+// Сборка из каталога search-server:
+// g++ -std=c++17 -O2 -DNDEBUG -I. benchmarks/search_benchmark.cpp $(ls *.cpp | grep -v '^main.cpp$') -o search_benchmark -ltbb -lpthread
+// Запуск: ./search_benchmark --documents=10000,1000000 --vocabulary=50000 --document-length=20 --stop-word-ratio=0.1
+
+#include "benchmarks/synthetic_corpus.h"
+#include "process_queries.h"
+#include "search_server.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct BenchmarkOptions {
+    vector<size_t> document_counts = { 10'000, 1'000'000, 10'000'000 };
+    CorpusOptions corpus;
+    size_t query_count = 1'000;
+    chrono::milliseconds min_time{ 500 };
+};
+
+struct BenchmarkResult {
+    string name;
+    size_t document_count = 0;
+    // операций за все прогоны
+    uint64_t operations = 0;
+    int64_t total_ns = 0;
+    // лучший прогон
+    double min_ns_per_operation = 0.0;
+    // сумма размеров результатов, должна совпадать у версий с одинаковой выдачей
+    uint64_t checksum = 0;
+    // GetIndexMemoryUsage после операции; 0, если не замерялась
+    size_t index_bytes = 0;
+};
+
+// Повторяет run, пока суммарное время не превысит min_time. run выполняет
+// operation_count операций и возвращает контрольную сумму результатов
+template <typename Run>
+BenchmarkResult Measure(string name, size_t document_count, size_t operation_count, chrono::milliseconds min_time, Run run) {
+    BenchmarkResult result{ move(name), document_count };
+    do {
+        const Clock::time_point start = Clock::now();
+        const uint64_t checksum = run();
+        const int64_t run_ns = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+        const double ns_per_operation = static_cast<double>(run_ns) / max<size_t>(operation_count, 1);
+        if (result.operations == 0 || ns_per_operation < result.min_ns_per_operation) {
+            result.min_ns_per_operation = ns_per_operation;
+        }
+        result.operations += operation_count;
+        result.total_ns += run_ns;
+        result.checksum = checksum;
+    } while (result.total_ns < chrono::duration_cast<chrono::nanoseconds>(min_time).count());
+    return result;
+}
+
+// Однократный замер операции, которую нельзя повторить на том же индексе
+template <typename Run>
+BenchmarkResult MeasureOnce(string name, size_t document_count, size_t operation_count, Run run) {
+    return Measure(move(name), document_count, operation_count, chrono::milliseconds(0), run);
+}
+
+void RunBenchmarks(const BenchmarkOptions& options, size_t document_count, vector<BenchmarkResult>& results) {
+    SyntheticCorpus corpus(options.corpus);
+    SearchServer search_server(corpus.GetStopWords());
+
+    results.push_back(MeasureOnce("AddDocument"s, document_count, document_count, [&] {
+        for (size_t id = 0; id < document_count; ++id) {
+            const string document = corpus.GenerateDocument();
+            const DocumentStatus status = corpus.GenerateStatus();
+            search_server.AddDocument(static_cast<int>(id), document, status, corpus.GenerateRatings());
+        }
+        return static_cast<uint64_t>(search_server.GetDocumentCount());
+    }));
+    results.back().index_bytes = search_server.GetIndexMemoryUsage();
+
+    vector<string> queries(options.query_count);
+    for (string& query : queries) {
+        query = corpus.GenerateQuery();
+    }
+    vector<int> match_ids(options.query_count);
+    for (int& id : match_ids) {
+        id = static_cast<int>(corpus.GenerateIndex(document_count));
+    }
+
+    const auto predicate = [](int, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL && rating > 0;
+    };
+    const auto find_top = [&](auto policy, auto&&... filter) {
+        uint64_t checksum = 0;
+        for (const string& query : queries) {
+            checksum += search_server.FindTopDocuments(policy, query, filter...).size();
+        }
+        return checksum;
+    };
+    const auto match = [&](auto policy) {
+        uint64_t checksum = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            checksum += get<0>(search_server.MatchDocument(policy, queries[i], match_ids[i])).size();
+        }
+        return checksum;
+    };
+
+    results.push_back(Measure("FindTopDocuments/seq/status"s, document_count, queries.size(), options.min_time, [&] {
+        return find_top(execution::seq, DocumentStatus::ACTUAL);
+    }));
+    results.push_back(Measure("FindTopDocuments/par/status"s, document_count, queries.size(), options.min_time, [&] {
+        return find_top(execution::par, DocumentStatus::ACTUAL);
+    }));
+    results.push_back(Measure("FindTopDocuments/seq/predicate"s, document_count, queries.size(), options.min_time, [&] {
+        return find_top(execution::seq, predicate);
+    }));
+    results.push_back(Measure("FindTopDocuments/par/predicate"s, document_count, queries.size(), options.min_time, [&] {
+        return find_top(execution::par, predicate);
+    }));
+    results.push_back(Measure("MatchDocument/seq"s, document_count, queries.size(), options.min_time, [&] {
+        return match(execution::seq);
+    }));
+    results.push_back(Measure("MatchDocument/par"s, document_count, queries.size(), options.min_time, [&] {
+        return match(execution::par);
+    }));
+    results.push_back(Measure("ProcessQueries"s, document_count, queries.size(), options.min_time, [&] {
+        uint64_t checksum = 0;
+        for (const vector<Document>& documents : ProcessQueries(search_server, queries)) {
+            checksum += documents.size();
+        }
+        return checksum;
+    }));
+    results.push_back(Measure("ProcessQueriesJoined"s, document_count, queries.size(), options.min_time, [&] {
+        return static_cast<uint64_t>(ProcessQueriesJoined(search_server, queries).size());
+    }));
+
+    // варианты удаляют разные документы: каждый не больше двадцатой части индекса и не больше query_count
+    const size_t remove_count = min(document_count / 20, options.query_count);
+    results.push_back(MeasureOnce("RemoveDocument/seq"s, document_count, remove_count, [&] {
+        for (size_t i = 0; i < remove_count; ++i) {
+            search_server.RemoveDocument(execution::seq, static_cast<int>(i * 20));
+        }
+        return static_cast<uint64_t>(search_server.GetDocumentCount());
+    }));
+    results.push_back(MeasureOnce("RemoveDocument/par"s, document_count, remove_count, [&] {
+        for (size_t i = 0; i < remove_count; ++i) {
+            search_server.RemoveDocument(execution::par, static_cast<int>(i * 20 + 10));
+        }
+        return static_cast<uint64_t>(search_server.GetDocumentCount());
+    }));
+
+    // одни и те же запросы к одному индексу до и после сжатия; контрольные суммы пар должны совпасть
+    const auto find_top_variants = [&](const string& suffix) {
+        results.push_back(Measure("FindTopDocuments/seq/status/"s + suffix, document_count, queries.size(), options.min_time, [&] {
+            return find_top(execution::seq, DocumentStatus::ACTUAL);
+        }));
+        results.push_back(Measure("FindTopDocuments/par/status/"s + suffix, document_count, queries.size(), options.min_time, [&] {
+            return find_top(execution::par, DocumentStatus::ACTUAL);
+        }));
+        results.push_back(Measure("FindTopDocuments/seq/predicate/"s + suffix, document_count, queries.size(), options.min_time, [&] {
+            return find_top(execution::seq, predicate);
+        }));
+        results.back().index_bytes = search_server.GetIndexMemoryUsage();
+    };
+    find_top_variants("uncompressed"s);
+    results.push_back(MeasureOnce("CompressIndex"s, document_count, 1, [&] {
+        search_server.CompressIndex();
+        return static_cast<uint64_t>(search_server.GetDocumentCount());
+    }));
+    results.back().index_bytes = search_server.GetIndexMemoryUsage();
+    find_top_variants("compressed"s);
+}
+
+vector<size_t> ParseCounts(string_view text) {
+    vector<size_t> counts;
+    while (!text.empty()) {
+        const size_t comma = text.find(',');
+        counts.push_back(stoull(string(text.substr(0, comma))));
+        text.remove_prefix(comma == text.npos ? text.size() : comma + 1);
+    }
+    if (counts.empty()) {
+        throw invalid_argument("Document counts must not be empty");
+    }
+    return counts;
+}
+
+BenchmarkOptions ParseOptions(int argc, char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t equals = argument.find('=');
+        if (argument.substr(0, 2) != "--" || equals == argument.npos) {
+            throw invalid_argument("Expected --name=value, got "s + string(argument));
+        }
+        const string_view name = argument.substr(2, equals - 2);
+        const string value(argument.substr(equals + 1));
+        if (name == "documents") {
+            options.document_counts = ParseCounts(value);
+        } else if (name == "vocabulary") {
+            options.corpus.vocabulary_size = stoull(value);
+        } else if (name == "document-length") {
+            options.corpus.document_length = stoull(value);
+        } else if (name == "stop-word-ratio") {
+            options.corpus.stop_word_ratio = stod(value);
+        } else if (name == "zipf-exponent") {
+            options.corpus.zipf_exponent = stod(value);
+        } else if (name == "queries") {
+            options.query_count = stoull(value);
+        } else if (name == "seed") {
+            options.corpus.seed = stoull(value);
+        } else if (name == "min-time-ms") {
+            options.min_time = chrono::milliseconds(stoll(value));
+        } else {
+            throw invalid_argument("Unknown option --"s + string(name));
+        }
+    }
+    return options;
+}
+
+void PrintJson(ostream& output, const BenchmarkOptions& options, const vector<BenchmarkResult>& results) {
+    output << "{\n  \"context\": {"
+           << "\"hardware_concurrency\": " << thread::hardware_concurrency()
+           << ", \"vocabulary\": " << options.corpus.vocabulary_size
+           << ", \"document_length\": " << options.corpus.document_length
+           << ", \"stop_word_ratio\": " << options.corpus.stop_word_ratio
+           << ", \"zipf_exponent\": " << options.corpus.zipf_exponent
+           << ", \"queries\": " << options.query_count
+           << ", \"seed\": " << options.corpus.seed << "},\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        output << (i == 0 ? "\n" : ",\n")
+               << "    {\"name\": \"" << result.name << "\", \"documents\": " << result.document_count
+               << ", \"operations\": " << result.operations
+               << ", \"ns_per_operation\": " << static_cast<double>(result.total_ns) / max<uint64_t>(result.operations, 1)
+               << ", \"min_ns_per_operation\": " << result.min_ns_per_operation
+               << ", \"checksum\": " << result.checksum;
+        if (result.index_bytes > 0) {
+            output << ", \"index_bytes\": " << result.index_bytes;
+        }
+        output << '}';
+    }
+    output << "\n  ]\n}" << endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const BenchmarkOptions options = ParseOptions(argc, argv);
+        vector<BenchmarkResult> results;
+        for (const size_t document_count : options.document_counts) {
+            cerr << "documents: "s << document_count << endl;
+            RunBenchmarks(options, document_count, results);
+        }
+        PrintJson(cout, options, results);
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+// Детерминированный синтетический корпус для бенчмарков: слова документов и
+// запросов распределены по закону Ципфа. Используются только mt19937_64 и
+// собственные преобразования случайных чисел, поэтому корпус с тем же seed
+// одинаков на любой стандартной библиотеке
+
+#include "document.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct CorpusOptions {
+    size_t vocabulary_size = 50'000;
+    // средняя длина документа; длина равномерно распределена в [length / 2, length * 3 / 2]
+    size_t document_length = 20;
+    // доля стоп-слов среди слов документов и запросов
+    double stop_word_ratio = 0.1;
+    size_t stop_word_count = 32;
+    double zipf_exponent = 1.0;
+    // плюс-слов в запросе от 1 до query_length
+    size_t query_length = 4;
+    // вероятность того, что слово запроса - минус-слово
+    double minus_word_ratio = 0.15;
+    uint64_t seed = 42;
+};
+
+class SyntheticCorpus {
+public:
+    explicit SyntheticCorpus(const CorpusOptions& options)
+        : options_(options)
+        , generator_(options.seed) {
+        if (options.vocabulary_size == 0 || options.document_length == 0 || options.query_length == 0) {
+            throw std::invalid_argument("Vocabulary, document length and query length must be positive");
+        }
+        if (options.stop_word_ratio < 0.0 || options.stop_word_ratio > 1.0
+            || options.minus_word_ratio < 0.0 || options.minus_word_ratio > 1.0) {
+            throw std::invalid_argument("Word ratios must be in [0, 1]");
+        }
+        if (options.stop_word_ratio > 0.0 && options.stop_word_count == 0) {
+            throw std::invalid_argument("Stop word ratio needs at least one stop word");
+        }
+
+        // первые stop_word_count слов - стоп-слова, остальные упорядочены по частоте
+        words_.reserve(options.stop_word_count + options.vocabulary_size);
+        for (size_t index = 0; index < options.stop_word_count + options.vocabulary_size; ++index) {
+            words_.push_back(MakeWord(index));
+        }
+        cumulative_weights_.reserve(options.vocabulary_size);
+        double weight_sum = 0.0;
+        for (size_t rank = 0; rank < options.vocabulary_size; ++rank) {
+            weight_sum += 1.0 / std::pow(static_cast<double>(rank + 1), options.zipf_exponent);
+            cumulative_weights_.push_back(weight_sum);
+        }
+        for (double& weight : cumulative_weights_) {
+            weight /= weight_sum;
+        }
+    }
+
+    // Стоп-слова через пробел для конструктора SearchServer
+    std::string GetStopWords() const {
+        std::string stop_words;
+        for (size_t index = 0; index < options_.stop_word_count; ++index) {
+            stop_words += words_[index];
+            stop_words += ' ';
+        }
+        return stop_words;
+    }
+
+    std::string GenerateDocument() {
+        const size_t min_length = std::max<size_t>(1, options_.document_length / 2);
+        const size_t length = min_length + GenerateIndex(options_.document_length + 1);
+        std::string document;
+        for (size_t i = 0; i < length; ++i) {
+            document += GenerateWord();
+            document += ' ';
+        }
+        return document;
+    }
+
+    std::string GenerateQuery() {
+        const size_t plus_word_count = 1 + GenerateIndex(options_.query_length);
+        std::string query;
+        for (size_t i = 0; i < plus_word_count; ++i) {
+            query += GenerateWord();
+            query += ' ';
+            if (GenerateProbability() < options_.minus_word_ratio) {
+                query += '-';
+                query += words_[options_.stop_word_count + GenerateRank()];
+                query += ' ';
+            }
+        }
+        return query;
+    }
+
+    // 70% ACTUAL, остальные статусы поровну
+    DocumentStatus GenerateStatus() {
+        const double value = GenerateProbability();
+        if (value < 0.7) {
+            return DocumentStatus::ACTUAL;
+        }
+        if (value < 0.8) {
+            return DocumentStatus::IRRELEVANT;
+        }
+        if (value < 0.9) {
+            return DocumentStatus::BANNED;
+        }
+        return DocumentStatus::REMOVED;
+    }
+
+    std::vector<int> GenerateRatings() {
+        std::vector<int> ratings(1 + GenerateIndex(5));
+        for (int& rating : ratings) {
+            rating = static_cast<int>(GenerateIndex(21)) - 10;
+        }
+        return ratings;
+    }
+
+    // Равномерное число из [0, count)
+    size_t GenerateIndex(size_t count) {
+        return static_cast<size_t>(generator_() % count);
+    }
+
+    double GenerateProbability() {
+        return static_cast<double>(generator_() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    CorpusOptions options_;
+    std::mt19937_64 generator_;
+    std::vector<std::string> words_;
+    std::vector<double> cumulative_weights_;
+
+    // Слово из строчных латинских букв, не короче двух, разное для разных index
+    static std::string MakeWord(size_t index) {
+        std::string word;
+        for (size_t value = index + 26; value > 0; value /= 26) {
+            word.push_back(static_cast<char>('a' + value % 26));
+        }
+        return word;
+    }
+
+    size_t GenerateRank() {
+        const double value = GenerateProbability();
+        const auto it = std::upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), value);
+        return std::min<size_t>(it - cumulative_weights_.begin(), cumulative_weights_.size() - 1);
+    }
+
+    const std::string& GenerateWord() {
+        if (options_.stop_word_count > 0 && GenerateProbability() < options_.stop_word_ratio) {
+            return words_[GenerateIndex(options_.stop_word_count)];
+        }
+        return words_[options_.stop_word_count + GenerateRank()];
+    }
+};
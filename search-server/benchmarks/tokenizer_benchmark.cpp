@@ -0,0 +1,113 @@
+// Сравнение WordTokenizer с прежним разбором через std::list.
+// Сборка из каталога search-server:
+// g++ -std=c++17 -O2 -I. benchmarks/tokenizer_benchmark.cpp string_processing.cpp -o tokenizer_benchmark
+
+#include "log_duration.h"
+#include "string_processing.h"
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Прежняя реализация SplitIntoWords
+list<string_view> SplitIntoWordsList(string_view text) {
+    list<string_view> words;
+
+    int i = 0;
+    int len = 0;
+    for_each(text.begin(), text.end(), [&](const char& c) {
+        if (c == ' ') {
+            if (len) {
+                words.push_back(text.substr(i, len));
+                i += len;
+                len = 0;
+            }
+            ++i;
+        } else {
+            ++len;
+        }
+    });
+
+    if (len) {
+        words.push_back(text.substr(i, len));
+    }
+
+    return words;
+}
+
+bool IsValidWord(string_view word) {
+    return none_of(word.begin(), word.end(), [](char c) {
+        return c >= '\0' && c < ' ';
+    });
+}
+
+vector<string> GenerateTexts(mt19937& generator, size_t text_count) {
+    vector<string> texts;
+    texts.reserve(text_count);
+    for (size_t i = 0; i < text_count; ++i) {
+        string text;
+        const int word_count = uniform_int_distribution(5, 64)(generator);
+        for (int j = 0; j < word_count; ++j) {
+            const int length = uniform_int_distribution(2, 10)(generator);
+            for (int k = 0; k < length; ++k) {
+                text.push_back(static_cast<char>(uniform_int_distribution('a', 'z')(generator)));
+            }
+            text.push_back(' ');
+        }
+        texts.push_back(move(text));
+    }
+    return texts;
+}
+
+} // namespace
+
+int main() {
+    mt19937 generator;
+    const auto texts = GenerateTexts(generator, 20'000);
+    const int repeat_count = 50;
+
+    size_t list_words = 0;
+    {
+        LOG_DURATION("list + copy + IsValidWord"s);
+        for (int repeat = 0; repeat < repeat_count; ++repeat) {
+            for (const string& text : texts) {
+                // так слова разбирались в SplitIntoWordsNoStop
+                vector<string_view> words;
+                for (const string_view word : SplitIntoWordsList(text)) {
+                    if (IsValidWord(word)) {
+                        words.push_back(word);
+                    }
+                }
+                list_words += words.size();
+            }
+        }
+    }
+
+    size_t tokenizer_words = 0;
+    {
+        LOG_DURATION("WordTokenizer"s);
+        vector<string_view> words;
+        for (int repeat = 0; repeat < repeat_count; ++repeat) {
+            for (const string& text : texts) {
+                words.clear();
+                WordTokenizer tokenizer(text);
+                for (Token token; tokenizer.Next(token);) {
+                    if (token.is_valid) {
+                        words.push_back(token.word);
+                    }
+                }
+                tokenizer_words += words.size();
+            }
+        }
+    }
+
+    cout << "words: "s << list_words / repeat_count << ", same result: "s << boolalpha << (list_words == tokenizer_words) << endl;
+}
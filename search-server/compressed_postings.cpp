@@ -0,0 +1,163 @@
+#include "compressed_postings.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+void WriteVarint(vector<uint8_t>& data, uint32_t value)
+{
+    while (value >= 0x80) {
+        data.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t ReadVarint(const uint8_t*& data, const uint8_t* end)
+{
+    uint32_t value = 0;
+    for (int shift = 0; data != end && shift < 32; shift += 7) {
+        const uint8_t byte = *data++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw runtime_error("Compressed postings are corrupted"s);
+}
+
+}
+
+CompressedPostings::CompressedPostings(const vector<Posting>& postings)
+{
+    for (const Posting& posting : postings) {
+        term_freqs_.push_back(posting.term_freq);
+    }
+    sort(term_freqs_.begin(), term_freqs_.end());
+    term_freqs_.erase(unique(term_freqs_.begin(), term_freqs_.end()), term_freqs_.end());
+    term_freqs_.shrink_to_fit();
+
+    blocks_.reserve((postings.size() + block_size - 1) / block_size);
+    int previous_ordinal = -1;
+    for (size_t position = 0; position < postings.size(); ++position) {
+        const Posting& posting = postings[position];
+        if (position % block_size == 0) {
+            blocks_.push_back({ posting.ordinal, static_cast<uint32_t>(data_.size()), 0.0 });
+        }
+        BlockHeader& block = blocks_.back();
+        block.last_ordinal = posting.ordinal;
+        block.max_term_freq = max(block.max_term_freq, posting.term_freq);
+        view_.max_term_freq = max(view_.max_term_freq, posting.term_freq);
+
+        WriteVarint(data_, static_cast<uint32_t>(posting.ordinal - previous_ordinal - 1));
+        previous_ordinal = posting.ordinal;
+        const auto code = lower_bound(term_freqs_.begin(), term_freqs_.end(), posting.term_freq) - term_freqs_.begin();
+        WriteVarint(data_, static_cast<uint32_t>(code));
+    }
+    data_.shrink_to_fit();
+
+    // перемещение вектора сохраняет его буфер, поэтому указатели остаются валидными
+    view_.blocks = blocks_.data();
+    view_.block_count = blocks_.size();
+    view_.data = data_.data();
+    view_.data_size = data_.size();
+    view_.term_freqs = term_freqs_.data();
+    view_.term_freq_count = term_freqs_.size();
+    view_.size = postings.size();
+}
+
+CompressedPostings::CompressedPostings(const View& view)
+    : view_(view)
+{
+}
+
+const CompressedPostings::View& CompressedPostings::GetView() const
+{
+    return view_;
+}
+
+size_t CompressedPostings::size() const
+{
+    return view_.size;
+}
+
+bool CompressedPostings::empty() const
+{
+    return view_.size == 0;
+}
+
+int CompressedPostings::GetLastOrdinal() const
+{
+    return view_.block_count == 0 ? -1 : view_.blocks[view_.block_count - 1].last_ordinal;
+}
+
+double CompressedPostings::GetMaxTermFreq() const
+{
+    return view_.max_term_freq;
+}
+
+size_t CompressedPostings::GetMemoryUsage() const
+{
+    return blocks_.capacity() * sizeof(BlockHeader) + data_.capacity() + term_freqs_.capacity() * sizeof(double);
+}
+
+size_t CompressedPostings::GetBlockCount() const
+{
+    return view_.block_count;
+}
+
+int CompressedPostings::GetBlockLastOrdinal(size_t block) const
+{
+    return view_.blocks[block].last_ordinal;
+}
+
+double CompressedPostings::GetBlockMaxTermFreq(size_t block) const
+{
+    return view_.blocks[block].max_term_freq;
+}
+
+size_t CompressedPostings::FindBlock(int ordinal, size_t first_block) const
+{
+    const BlockHeader* blocks_end = view_.blocks + view_.block_count;
+    return lower_bound(view_.blocks + first_block, blocks_end, ordinal, [](const BlockHeader& block, int ordinal) {
+        return block.last_ordinal < ordinal;
+    }) - view_.blocks;
+}
+
+size_t CompressedPostings::DecodeBlock(size_t block, Posting* output) const
+{
+    const size_t count = min(block_size, view_.size - block * block_size);
+    const uint8_t* data = view_.data + view_.blocks[block].offset;
+    const uint8_t* data_end = block + 1 < view_.block_count ? view_.data + view_.blocks[block + 1].offset : view_.data + view_.data_size;
+    const int last_ordinal = view_.blocks[block].last_ordinal;
+    int ordinal = block == 0 ? -1 : view_.blocks[block - 1].last_ordinal;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t gap = ReadVarint(data, data_end);
+        const uint32_t code = ReadVarint(data, data_end);
+        // номера строго растут и не выходят за последний номер блока
+        if (gap >= static_cast<uint32_t>(last_ordinal - ordinal) || code >= view_.term_freq_count) {
+            throw runtime_error("Compressed postings are corrupted"s);
+        }
+        ordinal += static_cast<int>(gap) + 1;
+        output[i].ordinal = ordinal;
+        output[i].term_freq = view_.term_freqs[code];
+    }
+    return count;
+}
+
+bool CompressedPostings::Contains(int ordinal) const
+{
+    const size_t block = FindBlock(ordinal);
+    if (block == view_.block_count) {
+        return false;
+    }
+    Posting postings[block_size];
+    const size_t count = DecodeBlock(block, postings);
+    return any_of(postings, postings + count, [ordinal](const Posting& posting) {
+        return posting.ordinal == ordinal;
+    });
+}
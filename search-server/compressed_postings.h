@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Posting {
+    int ordinal;
+    double term_freq;
+};
+
+// Неизменяемый сжатый список документов слова.
+// Документы хранятся блоками по block_size: номера разностями в varint,
+// term_freq кодом в varint по словарю различных значений списка.
+// term_freq вида (число вхождений / число слов) мало, так что код обычно
+// занимает байт, а распаковка возвращает исходные значения без потерь
+class CompressedPostings {
+public:
+    static constexpr size_t block_size = 128;
+
+    struct BlockHeader {
+        int last_ordinal;
+        uint32_t offset;
+        double max_term_freq;
+    };
+
+    // Расположение сжатых данных в памяти
+    struct View {
+        const BlockHeader* blocks = nullptr;
+        size_t block_count = 0;
+        const uint8_t* data = nullptr;
+        size_t data_size = 0;
+        const double* term_freqs = nullptr;
+        size_t term_freq_count = 0;
+        size_t size = 0;
+        double max_term_freq = 0.0;
+    };
+
+    CompressedPostings() = default;
+    // postings отсортированы по номеру
+    explicit CompressedPostings(const std::vector<Posting>& postings);
+    // Не владеет данными: они должны жить дольше объекта, например в снимке индекса
+    explicit CompressedPostings(const View& view);
+
+    CompressedPostings(const CompressedPostings&) = delete;
+    CompressedPostings& operator=(const CompressedPostings&) = delete;
+    CompressedPostings(CompressedPostings&&) = default;
+    CompressedPostings& operator=(CompressedPostings&&) = default;
+
+    const View& GetView() const;
+
+    size_t size() const;
+    bool empty() const;
+    int GetLastOrdinal() const;
+    double GetMaxTermFreq() const;
+    // Память, которой владеет объект; данные снимка не учитываются
+    size_t GetMemoryUsage() const;
+
+    size_t GetBlockCount() const;
+    int GetBlockLastOrdinal(size_t block) const;
+    double GetBlockMaxTermFreq(size_t block) const;
+    // Первый блок начиная с first_block, в котором может находиться ordinal
+    size_t FindBlock(int ordinal, size_t first_block = 0) const;
+    // Распаковывает блок в output, возвращает число документов в нём.
+    // Бросает std::runtime_error, если данные блока повреждены: так проявляется
+    // порча снимка, открытого без проверки контрольной суммы
+    size_t DecodeBlock(size_t block, Posting* output) const;
+
+    bool Contains(int ordinal) const;
+
+private:
+    View view_;
+
+    // пусты, если объект не владеет данными
+    std::vector<BlockHeader> blocks_;
+    std::vector<uint8_t> data_;
+    std::vector<double> term_freqs_;
+};
@@ -0,0 +1,44 @@
+#include "document_attributes.h"
+
+using namespace std;
+
+void DocumentAttributes::Add(DocumentStatus status, int rating)
+{
+    const size_t ordinal = statuses_.size();
+    statuses_.push_back(status);
+    ratings_.push_back(rating);
+    const size_t word_count = (statuses_.size() + 63) / 64;
+    for (auto& bits : status_bits_) {
+        bits.resize(word_count, 0);
+    }
+    const size_t index = static_cast<size_t>(status);
+    if (index < status_count_) {
+        status_bits_[index][ordinal >> 6] |= uint64_t{ 1 } << (ordinal & 63);
+    }
+}
+
+void DocumentAttributes::Remove(int ordinal)
+{
+    const size_t index = static_cast<size_t>(statuses_[ordinal]);
+    if (index < status_count_) {
+        status_bits_[index][ordinal >> 6] &= ~(uint64_t{ 1 } << (ordinal & 63));
+    }
+}
+
+size_t DocumentAttributes::GetMemoryUsage() const
+{
+    size_t memory_usage = statuses_.capacity() * sizeof(DocumentStatus) + ratings_.capacity() * sizeof(int);
+    for (const auto& bits : status_bits_) {
+        memory_usage += bits.capacity() * sizeof(uint64_t);
+    }
+    return memory_usage;
+}
+
+void DocumentAttributes::Reserve(size_t ordinal_count)
+{
+    statuses_.reserve(ordinal_count);
+    ratings_.reserve(ordinal_count);
+    for (auto& bits : status_bits_) {
+        bits.reserve((ordinal_count + 63) / 64);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "document.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Атрибуты документов по столбцам: статус и рейтинг по порядковому номеру,
+// а также битовое множество номеров живых документов для каждого статуса
+class DocumentAttributes {
+public:
+    // Добавляет документ со следующим порядковым номером
+    void Add(DocumentStatus status, int rating);
+    // Убирает номер из множества его статуса, столбцы не меняются
+    void Remove(int ordinal);
+    void Reserve(size_t ordinal_count);
+    size_t GetMemoryUsage() const;
+
+    DocumentStatus GetStatus(int ordinal) const
+    {
+        return statuses_[ordinal];
+    }
+
+    int GetRating(int ordinal) const
+    {
+        return ratings_[ordinal];
+    }
+
+    // Для статусов вне перечисления сравнивает столбец, не различая удалённые документы
+    bool HasStatus(int ordinal, DocumentStatus status) const
+    {
+        const size_t index = static_cast<size_t>(status);
+        if (index >= status_count_) {
+            return statuses_[ordinal] == status;
+        }
+        return (status_bits_[index][ordinal >> 6] >> (ordinal & 63)) & 1;
+    }
+
+private:
+    static constexpr size_t status_count_ = static_cast<size_t>(DocumentStatus::REMOVED) + 1;
+
+    std::vector<DocumentStatus> statuses_;
+    std::vector<int> ratings_;
+    std::array<std::vector<uint64_t>, status_count_> status_bits_;
+};
@@ -0,0 +1,423 @@
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const char snapshot_magic[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+
+uint64_t ComputeHeaderChecksum(IndexSnapshotHeader header)
+{
+    header.header_checksum = 0;
+    IndexSnapshotChecksum checksum;
+    checksum.Update(reinterpret_cast<const char*>(&header), sizeof(header));
+    return checksum.Finish();
+}
+
+}
+
+void IndexSnapshotChecksum::Update(const char* data, size_t size)
+{
+    while (pending_size_ > 0 && pending_size_ < sizeof(uint64_t) && size > 0) {
+        pending_ |= static_cast<uint64_t>(static_cast<unsigned char>(*data++)) << (8 * pending_size_++);
+        --size;
+    }
+    if (pending_size_ == sizeof(uint64_t)) {
+        UpdateWord(pending_);
+        pending_ = 0;
+        pending_size_ = 0;
+    }
+    for (; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        UpdateWord(word);
+    }
+    for (; size > 0; --size) {
+        pending_ |= static_cast<uint64_t>(static_cast<unsigned char>(*data++)) << (8 * pending_size_++);
+    }
+}
+
+uint64_t IndexSnapshotChecksum::Finish()
+{
+    UpdateWord(pending_ ^ (static_cast<uint64_t>(pending_size_) << 56));
+    pending_ = 0;
+    pending_size_ = 0;
+    return hash_ ^ (hash_ >> 32);
+}
+
+void IndexSnapshotChecksum::UpdateWord(uint64_t word)
+{
+    hash_ ^= word;
+    hash_ *= 0x9FB21C651E98DF25ull;
+    hash_ ^= hash_ >> 29;
+}
+
+IndexSnapshot::IndexSnapshot(const string& path, bool verify_checksum)
+    : file_(path)
+    , header_(reinterpret_cast<const IndexSnapshotHeader*>(file_.data()))
+{
+    if (file_.size() < sizeof(IndexSnapshotHeader) || memcmp(header_->magic, snapshot_magic, sizeof(snapshot_magic)) != 0) {
+        throw runtime_error("File "s + path + " is not an index snapshot"s);
+    }
+    if (header_->version != version) {
+        throw runtime_error("Unsupported index snapshot version "s + to_string(header_->version));
+    }
+    if (ComputeHeaderChecksum(*header_) != header_->header_checksum) {
+        throw runtime_error("Index snapshot "s + path + " is corrupted"s);
+    }
+    if (header_->file_size != file_.size()) {
+        throw runtime_error("Index snapshot "s + path + " is truncated"s);
+    }
+    if (verify_checksum) {
+        IndexSnapshotChecksum checksum;
+        checksum.Update(file_.data() + sizeof(IndexSnapshotHeader), file_.size() - sizeof(IndexSnapshotHeader));
+        if (checksum.Finish() != header_->checksum) {
+            throw runtime_error("Index snapshot "s + path + " is corrupted"s);
+        }
+    }
+
+    CheckSection(header_->stop_word_offsets, sizeof(uint64_t), header_->stop_word_offsets.size / sizeof(uint64_t));
+    CheckSection(header_->stop_word_chars, 1, header_->stop_word_chars.size);
+    const size_t term_count = GetTermCount();
+    CheckSection(header_->term_sorted_ids, sizeof(uint32_t), term_count);
+    CheckSection(header_->term_offsets, sizeof(uint64_t), term_count + 1);
+    CheckSection(header_->term_chars, 1, header_->term_chars.size);
+    CheckSection(header_->postings, sizeof(IndexSnapshotPostings), term_count);
+    CheckSection(header_->posting_data, 1, header_->posting_data.size);
+    CheckSection(header_->term_log_document_freqs, sizeof(double), term_count);
+    CheckSection(header_->documents, sizeof(IndexSnapshotDocument), GetDocumentCount());
+    const size_t document_term_count = header_->document_term_ids.size / sizeof(int32_t);
+    CheckSection(header_->document_term_ids, sizeof(int32_t), document_term_count);
+    CheckSection(header_->document_term_freqs, sizeof(double), document_term_count);
+    if (header_->stop_word_offsets.size == 0
+        || GetSection<uint64_t>(header_->stop_word_offsets)[header_->stop_word_offsets.size / sizeof(uint64_t) - 1] > header_->stop_word_chars.size
+        || GetSection<uint64_t>(header_->term_offsets)[term_count] > header_->term_chars.size) {
+        throw runtime_error("Index snapshot "s + path + " is corrupted"s);
+    }
+    // дальше индексы и смещения из файла используются без проверок, поэтому они
+    // проверяются здесь один раз; содержимое блоков проверяет DecodeBlock
+    CheckTerms();
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        CheckPostings(term_id);
+    }
+    CheckDocuments();
+}
+
+vector<string_view> IndexSnapshot::GetStopWords() const
+{
+    const uint64_t* offsets = GetSection<uint64_t>(header_->stop_word_offsets);
+    const char* chars = GetSection<char>(header_->stop_word_chars);
+    vector<string_view> stop_words;
+    for (size_t i = 0; i + 1 < header_->stop_word_offsets.size / sizeof(uint64_t); ++i) {
+        stop_words.emplace_back(chars + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i]));
+    }
+    return stop_words;
+}
+
+TermDictionary::Table IndexSnapshot::GetTermTable() const
+{
+    TermDictionary::Table table;
+    table.chars = GetSection<char>(header_->term_chars);
+    table.offsets = GetSection<uint64_t>(header_->term_offsets);
+    table.sorted_ids = GetSection<uint32_t>(header_->term_sorted_ids);
+    table.size = GetTermCount();
+    return table;
+}
+
+size_t IndexSnapshot::GetTermCount() const
+{
+    return header_->term_sorted_ids.size / sizeof(uint32_t);
+}
+
+CompressedPostings::View IndexSnapshot::GetPostings(int term_id) const
+{
+    const IndexSnapshotPostings& postings = GetSection<IndexSnapshotPostings>(header_->postings)[term_id];
+    const char* data = GetSection<char>(header_->posting_data);
+    CompressedPostings::View view;
+    view.blocks = reinterpret_cast<const CompressedPostings::BlockHeader*>(data + postings.blocks_offset);
+    view.block_count = postings.block_count;
+    view.data = reinterpret_cast<const uint8_t*>(data + postings.data_offset);
+    view.data_size = postings.data_size;
+    view.term_freqs = reinterpret_cast<const double*>(data + postings.term_freqs_offset);
+    view.term_freq_count = postings.term_freq_count;
+    view.size = postings.size;
+    view.max_term_freq = postings.max_term_freq;
+    return view;
+}
+
+const double* IndexSnapshot::GetTermLogDocumentFreqs() const
+{
+    return GetSection<double>(header_->term_log_document_freqs);
+}
+
+size_t IndexSnapshot::GetDocumentCount() const
+{
+    return header_->documents.size / sizeof(IndexSnapshotDocument);
+}
+
+const IndexSnapshotDocument& IndexSnapshot::GetDocument(int ordinal) const
+{
+    return GetSection<IndexSnapshotDocument>(header_->documents)[ordinal];
+}
+
+const int* IndexSnapshot::GetDocumentTermIds(int ordinal) const
+{
+    return GetSection<int32_t>(header_->document_term_ids) + GetDocument(ordinal).first_term;
+}
+
+const double* IndexSnapshot::GetDocumentTermFreqs(int ordinal) const
+{
+    return GetSection<double>(header_->document_term_freqs) + GetDocument(ordinal).first_term;
+}
+
+template <typename T>
+const T* IndexSnapshot::GetSection(const IndexSnapshotSection& section) const
+{
+    return reinterpret_cast<const T*>(file_.data() + section.offset);
+}
+
+void IndexSnapshot::CheckSection(const IndexSnapshotSection& section, size_t item_size, size_t item_count) const
+{
+    if (section.offset < sizeof(IndexSnapshotHeader) || section.offset % sizeof(uint64_t) != 0
+        || section.size != item_size * item_count
+        || section.offset > file_.size() || section.size > file_.size() - section.offset) {
+        throw runtime_error("Index snapshot layout is corrupted"s);
+    }
+}
+
+void IndexSnapshot::CheckTerms() const
+{
+    const uint64_t* stop_word_offsets = GetSection<uint64_t>(header_->stop_word_offsets);
+    const uint64_t* term_offsets = GetSection<uint64_t>(header_->term_offsets);
+    const uint32_t* sorted_ids = GetSection<uint32_t>(header_->term_sorted_ids);
+    const size_t term_count = GetTermCount();
+    if (!is_sorted(stop_word_offsets, stop_word_offsets + header_->stop_word_offsets.size / sizeof(uint64_t))
+        || !is_sorted(term_offsets, term_offsets + term_count + 1)
+        || any_of(sorted_ids, sorted_ids + term_count, [term_count](uint32_t term_id) {
+               return term_id >= term_count;
+           })) {
+        throw runtime_error("Index snapshot terms are corrupted"s);
+    }
+}
+
+void IndexSnapshot::CheckPostings(size_t term_id) const
+{
+    const IndexSnapshotPostings& postings = GetSection<IndexSnapshotPostings>(header_->postings)[term_id];
+    const uint64_t data_size = header_->posting_data.size;
+    const size_t block_size = CompressedPostings::block_size;
+    if (postings.blocks_offset % sizeof(uint64_t) != 0 || postings.term_freqs_offset % sizeof(uint64_t) != 0
+        || postings.blocks_offset > data_size || postings.block_count * sizeof(CompressedPostings::BlockHeader) > data_size - postings.blocks_offset
+        || postings.data_offset > data_size || postings.data_size > data_size - postings.data_offset
+        || postings.term_freqs_offset > data_size || postings.term_freq_count * sizeof(double) > data_size - postings.term_freqs_offset
+        || postings.block_count != (postings.size + block_size - 1) / block_size
+        || (postings.size > 0 && postings.term_freq_count == 0)) {
+        throw runtime_error("Index snapshot postings are corrupted"s);
+    }
+
+    // читаются только заголовки блоков, сами блоки не трогаются
+    const auto* blocks = reinterpret_cast<const CompressedPostings::BlockHeader*>(GetSection<char>(header_->posting_data) + postings.blocks_offset);
+    int64_t previous_ordinal = -1;
+    uint32_t previous_offset = 0;
+    for (uint32_t block = 0; block < postings.block_count; ++block) {
+        if (blocks[block].last_ordinal <= previous_ordinal || blocks[block].offset < previous_offset
+            || blocks[block].offset > postings.data_size) {
+            throw runtime_error("Index snapshot postings are corrupted"s);
+        }
+        previous_ordinal = blocks[block].last_ordinal;
+        previous_offset = blocks[block].offset;
+    }
+    if (previous_ordinal >= static_cast<int64_t>(GetDocumentCount())) {
+        throw runtime_error("Index snapshot postings are corrupted"s);
+    }
+}
+
+void IndexSnapshot::CheckDocuments() const
+{
+    const IndexSnapshotDocument* documents = GetSection<IndexSnapshotDocument>(header_->documents);
+    const uint64_t document_term_count = header_->document_term_ids.size / sizeof(int32_t);
+    int64_t previous_id = -1;
+    for (size_t ordinal = 0; ordinal < GetDocumentCount(); ++ordinal) {
+        const IndexSnapshotDocument& document = documents[ordinal];
+        if (document.id <= previous_id || document.status < 0 || document.status > static_cast<int32_t>(DocumentStatus::REMOVED)
+            || document.first_term > document_term_count || document.term_count > document_term_count - document.first_term) {
+            throw runtime_error("Index snapshot documents are corrupted"s);
+        }
+        previous_id = document.id;
+    }
+
+    const int32_t* term_ids = GetSection<int32_t>(header_->document_term_ids);
+    const size_t term_count = GetTermCount();
+    if (any_of(term_ids, term_ids + document_term_count, [term_count](int32_t term_id) {
+            return term_id < 0 || static_cast<size_t>(term_id) >= term_count;
+        })) {
+        throw runtime_error("Index snapshot documents are corrupted"s);
+    }
+}
+
+IndexSnapshotWriter::IndexSnapshotWriter(const string& path)
+    : out_(path + ".tmp"s, ios::binary | ios::trunc)
+    , path_(path)
+{
+    if (!out_) {
+        throw runtime_error("Cannot create file "s + path + ".tmp"s);
+    }
+    // заголовок перезаписывается в Finish, когда известны разделы и сумма
+    out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    position_ = sizeof(header_);
+}
+
+IndexSnapshotWriter::~IndexSnapshotWriter()
+{
+    if (!is_finished_) {
+        out_.close();
+        error_code error;
+        filesystem::remove(path_ + ".tmp"s, error);
+    }
+}
+
+void IndexSnapshotWriter::WriteStopWords(const StopWordSet& stop_words)
+{
+    vector<uint64_t> offsets = { 0 };
+    string chars;
+    for (const string_view word : stop_words) {
+        chars += word;
+        offsets.push_back(chars.size());
+    }
+    header_.stop_word_offsets = WriteSection(offsets.data(), offsets.size() * sizeof(uint64_t));
+    header_.stop_word_chars = WriteSection(chars.data(), chars.size());
+}
+
+void IndexSnapshotWriter::WriteTerms(const TermDictionary& terms)
+{
+    const size_t term_count = terms.size();
+    vector<uint64_t> offsets(term_count + 1, 0);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        offsets[term_id + 1] = offsets[term_id] + terms.GetTerm(static_cast<int>(term_id)).size();
+    }
+    Align();
+    header_.term_chars.offset = position_;
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        const string_view term = terms.GetTerm(static_cast<int>(term_id));
+        Write(term.data(), term.size());
+    }
+    header_.term_chars.size = position_ - header_.term_chars.offset;
+    header_.term_offsets = WriteSection(offsets.data(), offsets.size() * sizeof(uint64_t));
+
+    vector<uint32_t> sorted_ids(term_count);
+    iota(sorted_ids.begin(), sorted_ids.end(), 0u);
+    sort(sorted_ids.begin(), sorted_ids.end(), [&terms](uint32_t lhs, uint32_t rhs) {
+        return terms.GetTerm(static_cast<int>(lhs)) < terms.GetTerm(static_cast<int>(rhs));
+    });
+    header_.term_sorted_ids = WriteSection(sorted_ids.data(), sorted_ids.size() * sizeof(uint32_t));
+
+    Align();
+    header_.posting_data.offset = position_;
+    postings_.reserve(term_count);
+}
+
+void IndexSnapshotWriter::WritePostings(const CompressedPostings& postings)
+{
+    const CompressedPostings::View& view = postings.GetView();
+    IndexSnapshotPostings record{};
+    Align();
+    record.blocks_offset = position_ - header_.posting_data.offset;
+    Write(view.blocks, view.block_count * sizeof(CompressedPostings::BlockHeader));
+    record.term_freqs_offset = position_ - header_.posting_data.offset;
+    Write(view.term_freqs, view.term_freq_count * sizeof(double));
+    record.data_offset = position_ - header_.posting_data.offset;
+    Write(view.data, view.data_size);
+    record.size = view.size;
+    record.block_count = static_cast<uint32_t>(view.block_count);
+    record.data_size = static_cast<uint32_t>(view.data_size);
+    record.term_freq_count = static_cast<uint32_t>(view.term_freq_count);
+    record.max_term_freq = view.max_term_freq;
+    postings_.push_back(record);
+    // так же, как SearchServer, чтобы IDF открытого снимка совпадала до бита
+    term_log_document_freqs_.push_back(view.size > 0 ? log(static_cast<double>(view.size)) : 0.0);
+}
+
+void IndexSnapshotWriter::WriteDocument(int document_id, int rating, DocumentStatus status,
+                                        const int* term_ids, const double* term_freqs, size_t term_count)
+{
+    if (!postings_finished_) {
+        FinishPostings();
+    }
+    documents_.push_back({ document_id, rating, static_cast<int32_t>(status), static_cast<uint32_t>(term_count),
+                           static_cast<uint64_t>(document_term_freqs_.size()) });
+    Write(term_ids, term_count * sizeof(int32_t));
+    document_term_freqs_.insert(document_term_freqs_.end(), term_freqs, term_freqs + term_count);
+}
+
+void IndexSnapshotWriter::Finish()
+{
+    if (!postings_finished_) {
+        FinishPostings();
+    }
+    header_.document_term_ids.size = position_ - header_.document_term_ids.offset;
+    header_.documents = WriteSection(documents_.data(), documents_.size() * sizeof(IndexSnapshotDocument));
+    header_.document_term_freqs = WriteSection(document_term_freqs_.data(), document_term_freqs_.size() * sizeof(double));
+
+    memcpy(header_.magic, snapshot_magic, sizeof(snapshot_magic));
+    header_.version = IndexSnapshot::version;
+    header_.file_size = position_;
+    header_.checksum = checksum_.Finish();
+    header_.header_checksum = ComputeHeaderChecksum(header_);
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    out_.close();
+    if (!out_) {
+        throw runtime_error("Cannot write index snapshot "s + path_);
+    }
+    // старый файл может быть отображён в память открытым сервером: замена
+    // через rename не трогает его содержимое, а читатели не видят недописанный снимок
+    error_code error;
+    filesystem::rename(path_ + ".tmp"s, path_, error);
+    if (error) {
+        throw runtime_error("Cannot replace index snapshot "s + path_ + ": "s + error.message());
+    }
+    is_finished_ = true;
+}
+
+void IndexSnapshotWriter::FinishPostings()
+{
+    header_.posting_data.size = position_ - header_.posting_data.offset;
+    header_.postings = WriteSection(postings_.data(), postings_.size() * sizeof(IndexSnapshotPostings));
+    header_.term_log_document_freqs = WriteSection(term_log_document_freqs_.data(), term_log_document_freqs_.size() * sizeof(double));
+    Align();
+    header_.document_term_ids.offset = position_;
+    postings_finished_ = true;
+}
+
+void IndexSnapshotWriter::Write(const void* data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    out_.write(static_cast<const char*>(data), size);
+    if (!out_) {
+        throw runtime_error("Cannot write index snapshot "s + path_);
+    }
+    checksum_.Update(static_cast<const char*>(data), size);
+    position_ += size;
+}
+
+void IndexSnapshotWriter::Align()
+{
+    const char padding[sizeof(uint64_t)] = {};
+    Write(padding, (sizeof(uint64_t) - position_ % sizeof(uint64_t)) % sizeof(uint64_t));
+}
+
+IndexSnapshotSection IndexSnapshotWriter::WriteSection(const void* data, size_t size)
+{
+    Align();
+    const IndexSnapshotSection section = { position_, size };
+    Write(data, size);
+    return section;
+}
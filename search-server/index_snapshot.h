@@ -0,0 +1,169 @@
+#pragma once
+
+#include "compressed_postings.h"
+#include "document.h"
+#include "mapped_file.h"
+#include "stop_word_set.h"
+#include "term_dictionary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Снимок индекса - один файл с заголовком и разделами, выровненными по 8 байт.
+// Числа записываются в порядке байт машины, поэтому снимок переносим только
+// между машинами с одинаковым порядком байт. Заголовок защищён своей
+// контрольной суммой, которая проверяется при каждом открытии. Сумма всего
+// файла после заголовка проверяется только по запросу: для этого файл
+// читается целиком
+
+struct IndexSnapshotSection {
+    uint64_t offset;
+    // в байтах
+    uint64_t size;
+};
+
+struct IndexSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t file_size;
+    // по всему файлу после заголовка
+    uint64_t checksum;
+    // по заголовку, в котором header_checksum == 0
+    uint64_t header_checksum;
+
+    // uint64_t[n + 1] границ стоп-слов и их символы
+    IndexSnapshotSection stop_word_offsets;
+    IndexSnapshotSection stop_word_chars;
+    // словарь в формате TermDictionary::Table
+    IndexSnapshotSection term_offsets;
+    IndexSnapshotSection term_chars;
+    IndexSnapshotSection term_sorted_ids;
+    // IndexSnapshotPostings по id слова, смещения в них - от начала posting_data
+    IndexSnapshotSection postings;
+    IndexSnapshotSection posting_data;
+    // double по id слова: логарифм числа документов со словом, 0 для пустых списков
+    IndexSnapshotSection term_log_document_freqs;
+    // IndexSnapshotDocument по порядковому номеру, номера идут по возрастанию id
+    IndexSnapshotSection documents;
+    // слова документов по возрастанию id слова: int и term_freq
+    IndexSnapshotSection document_term_ids;
+    IndexSnapshotSection document_term_freqs;
+};
+
+struct IndexSnapshotPostings {
+    uint64_t blocks_offset;
+    uint64_t data_offset;
+    uint64_t term_freqs_offset;
+    uint64_t size;
+    uint32_t block_count;
+    uint32_t data_size;
+    uint32_t term_freq_count;
+    uint32_t reserved;
+    double max_term_freq;
+};
+
+struct IndexSnapshotDocument {
+    int32_t id;
+    int32_t rating;
+    int32_t status;
+    uint32_t term_count;
+    uint64_t first_term;
+};
+
+// Контрольная сумма снимка: обрабатывает данные словами по 8 байт
+class IndexSnapshotChecksum {
+public:
+    void Update(const char* data, size_t size);
+    uint64_t Finish();
+
+private:
+    uint64_t hash_ = 0x9E3779B97F4A7C15ull;
+    uint64_t pending_ = 0;
+    size_t pending_size_ = 0;
+
+    void UpdateWord(uint64_t word);
+};
+
+// Открытый снимок. Данные не копируются, поэтому снимок должен жить, пока
+// используются полученные из него указатели
+class IndexSnapshot {
+public:
+    static constexpr uint32_t version = 2;
+
+    // Бросает std::runtime_error, если файл не является снимком этой версии или
+    // его структура повреждена: разделы, словарь, заголовки списков и блоков,
+    // документы и id их слов. Без verify_checksum содержимое блоков списков
+    // не читается, его проверяет CompressedPostings::DecodeBlock
+    explicit IndexSnapshot(const std::string& path, bool verify_checksum = false);
+
+    std::vector<std::string_view> GetStopWords() const;
+    TermDictionary::Table GetTermTable() const;
+
+    size_t GetTermCount() const;
+    CompressedPostings::View GetPostings(int term_id) const;
+    const double* GetTermLogDocumentFreqs() const;
+
+    size_t GetDocumentCount() const;
+    const IndexSnapshotDocument& GetDocument(int ordinal) const;
+    const int* GetDocumentTermIds(int ordinal) const;
+    const double* GetDocumentTermFreqs(int ordinal) const;
+
+private:
+    MappedFile file_;
+    const IndexSnapshotHeader* header_;
+
+    template <typename T>
+    const T* GetSection(const IndexSnapshotSection& section) const;
+    void CheckSection(const IndexSnapshotSection& section, size_t item_size, size_t item_count) const;
+    void CheckTerms() const;
+    void CheckPostings(size_t term_id) const;
+    void CheckDocuments() const;
+};
+
+// Пишет снимок во временный файл рядом с path и в Finish заменяет им path.
+// Если Finish не завершился, временный файл удаляется в деструкторе.
+// Разделы записываются строго в порядке вызовов:
+// стоп-слова, словарь, списки всех слов по id, документы по возрастанию id
+class IndexSnapshotWriter {
+public:
+    // Бросает std::runtime_error, если файл не удаётся создать или записать
+    explicit IndexSnapshotWriter(const std::string& path);
+    ~IndexSnapshotWriter();
+
+    IndexSnapshotWriter(const IndexSnapshotWriter&) = delete;
+    IndexSnapshotWriter& operator=(const IndexSnapshotWriter&) = delete;
+
+    void WriteStopWords(const StopWordSet& stop_words);
+    void WriteTerms(const TermDictionary& terms);
+    // Вызывается для каждого слова словаря по возрастанию id
+    void WritePostings(const CompressedPostings& postings);
+    void WriteDocument(int document_id, int rating, DocumentStatus status,
+                       const int* term_ids, const double* term_freqs, size_t term_count);
+    void Finish();
+
+private:
+    std::ofstream out_;
+    std::string path_;
+    IndexSnapshotHeader header_{};
+    IndexSnapshotChecksum checksum_;
+    uint64_t position_ = 0;
+
+    bool is_finished_ = false;
+
+    std::vector<IndexSnapshotPostings> postings_;
+    std::vector<double> term_log_document_freqs_;
+    bool postings_finished_ = false;
+    std::vector<IndexSnapshotDocument> documents_;
+    std::vector<double> document_term_freqs_;
+
+    void FinishPostings();
+    void Write(const void* data, size_t size);
+    void Align();
+    IndexSnapshotSection WriteSection(const void* data, size_t size);
+};
@@ -1,5 +1,6 @@
 #include "process_queries.h"
 #include "search_server.h"
+#include "test-example_functions.h"
 
 #include <execution>
 #include <iostream>
@@ -14,6 +15,8 @@ using namespace std;
 }*/
 
 int main() {
+    TestSearchServer();
+
     SearchServer search_server("and with"s);
 
     int id = 0;
@@ -1,14 +1,19 @@
 #pragma once
 
-#include <vector>
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 #include "document.h"
 
 template <typename Iterator>
 class IteratorRange {
     public:
         IteratorRange(Iterator begin, Iterator end)
-            : begin_(begin), end_(end), size_(std::distance(begin_, end_))
+            : begin_(begin), end_(end)
         {
         }
 
@@ -22,14 +27,14 @@ class IteratorRange {
             return end_;
         }
 
+        // Для итераторов без произвольного доступа проходит по диапазону
         size_t size() const
         {
-            return size_;
+            return std::distance(begin_, end_);
         }
 
     private:
         Iterator begin_, end_;
-        size_t size_;
 };
 
 template <typename Iterator>
@@ -42,38 +47,130 @@ std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range
     return out;
 }
 
+// Страницы вычисляются при обходе: хранятся только границы контейнера
+// и размер страницы, поэтому создание Paginator не проходит по контейнеру.
+// Бросает invalid_argument, если page_size равен нулю
 template <typename Iterator>
 class Paginator {
     public:
+        // Страница создаётся при разыменовании, поэтому итератор только входной
+        class PageIterator {
+            public:
+                // operator-> возвращает страницу по значению вместе с указателем на неё
+                class PagePointer {
+                    public:
+                        explicit PagePointer(IteratorRange<Iterator> page)
+                            : page_(page)
+                        {
+                        }
+
+                        const IteratorRange<Iterator>* operator->() const
+                        {
+                            return &page_;
+                        }
+
+                    private:
+                        IteratorRange<Iterator> page_;
+                };
+
+                using iterator_category = std::input_iterator_tag;
+                using value_type = IteratorRange<Iterator>;
+                using difference_type = std::ptrdiff_t;
+                using pointer = PagePointer;
+                using reference = value_type;
+
+                PageIterator() = default;
+
+                PageIterator(Iterator begin, Iterator end, size_t page_size)
+                    : begin_(begin), end_(end), page_size_(page_size)
+                {
+                }
+
+                reference operator*() const
+                {
+                    return { begin_, GetPageEnd() };
+                }
+
+                pointer operator->() const
+                {
+                    return PagePointer(**this);
+                }
+
+                PageIterator& operator++()
+                {
+                    begin_ = GetPageEnd();
+                    return *this;
+                }
+
+                PageIterator operator++(int)
+                {
+                    PageIterator previous = *this;
+                    ++*this;
+                    return previous;
+                }
+
+                bool operator==(const PageIterator& other) const
+                {
+                    return begin_ == other.begin_;
+                }
+
+                bool operator!=(const PageIterator& other) const
+                {
+                    return !(*this == other);
+                }
+
+            private:
+                Iterator begin_{};
+                Iterator end_{};
+                size_t page_size_ = 0;
+
+                Iterator GetPageEnd() const
+                {
+                    using Category = typename std::iterator_traits<Iterator>::iterator_category;
+                    if constexpr (std::is_base_of_v<std::random_access_iterator_tag, Category>)
+                    {
+                        return std::next(begin_, std::min<difference_type>(page_size_, std::distance(begin_, end_)));
+                    }
+                    else
+                    {
+                        Iterator page_end = begin_;
+                        for (size_t i = 0; i < page_size_ && page_end != end_; ++i)
+                        {
+                            ++page_end;
+                        }
+                        return page_end;
+                    }
+                }
+        };
+
         Paginator(Iterator begin, Iterator end, size_t page_size)
+            : begin_(begin), end_(end), page_size_(page_size)
         {
-            for (size_t left = std::distance(begin, end); left > 0;)
+            if (page_size == 0)
             {
-                const size_t current_page_size = std::min(page_size, left);
-                const Iterator current_page_end = std::next(begin, current_page_size);
-                pages_.push_back({ begin, current_page_end });
-                left -= current_page_size;
-                begin = current_page_end;
+                throw std::invalid_argument("Page size must be positive");
             }
         }
 
-        auto begin() const
+        PageIterator begin() const
         {
-            return pages_.begin();
+            return { begin_, end_, page_size_ };
         }
 
-        auto end() const
+        PageIterator end() const
         {
-            return pages_.end();
+            return { end_, end_, page_size_ };
         }
 
+        // Для итераторов без произвольного доступа проходит по контейнеру
         size_t size() const
         {
-            return pages_.size();
+            return (static_cast<size_t>(std::distance(begin_, end_)) + page_size_ - 1) / page_size_;
         }
 
     private:
-        std::vector<IteratorRange<Iterator>> pages_;
+        Iterator begin_, end_;
+        size_t page_size_;
 };
 
 template <typename Container>
@@ -0,0 +1,390 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+namespace {
+
+bool IsLessByOrdinal(const Posting& lhs, const Posting& rhs)
+{
+    return lhs.ordinal < rhs.ordinal;
+}
+
+}
+
+PostingList::PostingList(CompressedPostings frozen)
+    : frozen_(move(frozen))
+{
+    RebuildBlocks();
+}
+
+void PostingList::Add(int ordinal, double term_freq)
+{
+    max_term_freq_ = max(max_term_freq_, term_freq);
+    // обычный случай: документы добавляются по возрастанию номера
+    const int last_ordinal = postings_.empty() ? frozen_.GetLastOrdinal() : postings_.back().ordinal;
+    if (delta_.empty() && last_ordinal < ordinal) {
+        postings_.push_back({ ordinal, term_freq });
+        UpdateBlock(postings_.size() - 1);
+        return;
+    }
+
+    auto it = FindPosting(ordinal);
+    if (it != postings_.end()) {
+        if (it->term_freq == 0.0) {
+            --removed_count_;
+        }
+        it->term_freq = term_freq;
+        UpdateBlock(it - postings_.begin());
+        return;
+    }
+
+    // сжатую часть не меняем: старое значение считаем удалённым
+    if (!IsFrozenRemoved(ordinal) && frozen_.Contains(ordinal)) {
+        frozen_removed_.insert(lower_bound(frozen_removed_.begin(), frozen_removed_.end(), ordinal), ordinal);
+    }
+
+    auto delta_it = find_if(delta_.begin(), delta_.end(), [ordinal](const Posting& posting) {
+        return posting.ordinal == ordinal;
+    });
+    if (delta_it != delta_.end()) {
+        delta_it->term_freq = term_freq;
+        return;
+    }
+    delta_.push_back({ ordinal, term_freq });
+    if (delta_.size() >= max(min_merge_size_, postings_.size() / 8)) {
+        Merge();
+    }
+}
+
+void PostingList::Remove(int ordinal)
+{
+    auto it = FindPosting(ordinal);
+    if (it != postings_.end()) {
+        if (it->term_freq != 0.0) {
+            it->term_freq = 0.0;
+            ++removed_count_;
+        }
+    }
+    else {
+        auto delta_it = find_if(delta_.begin(), delta_.end(), [ordinal](const Posting& posting) {
+            return posting.ordinal == ordinal;
+        });
+        if (delta_it != delta_.end()) {
+            *delta_it = delta_.back();
+            delta_.pop_back();
+        }
+        else if (ordinal <= frozen_.GetLastOrdinal() && !IsFrozenRemoved(ordinal) && frozen_.Contains(ordinal)) {
+            frozen_removed_.insert(lower_bound(frozen_removed_.begin(), frozen_removed_.end(), ordinal), ordinal);
+        }
+    }
+
+    if (removed_count_ >= max(min_merge_size_, postings_.size() / 4)) {
+        Merge();
+    }
+}
+
+void PostingList::Remove(const int* first_ordinal, const int* last_ordinal)
+{
+    if (first_ordinal == last_ordinal) {
+        return;
+    }
+    RemoveFrozen(first_ordinal, lower_bound(first_ordinal, last_ordinal, frozen_.GetLastOrdinal() + 1));
+
+    // удалённые ранее и удаляемые сейчас документы убираются одним проходом
+    const int* removed_it = first_ordinal;
+    postings_.erase(remove_if(postings_.begin(), postings_.end(), [&](const Posting& posting) {
+        while (removed_it != last_ordinal && *removed_it < posting.ordinal) {
+            ++removed_it;
+        }
+        return posting.term_freq == 0.0 || (removed_it != last_ordinal && *removed_it == posting.ordinal);
+    }), postings_.end());
+    removed_count_ = 0;
+    delta_.erase(remove_if(delta_.begin(), delta_.end(), [&](const Posting& posting) {
+        return binary_search(first_ordinal, last_ordinal, posting.ordinal);
+    }), delta_.end());
+    Merge();
+}
+
+void PostingList::RemoveFrozen(const int* first_ordinal, const int* last_ordinal)
+{
+    if (frozen_.empty() || first_ordinal == last_ordinal) {
+        return;
+    }
+    // немногие удаления только отмечаются, чтобы не распаковывать весь список
+    if (static_cast<size_t>(last_ordinal - first_ordinal) * CompressedPostings::block_size < frozen_.size()) {
+        vector<int> removed;
+        for (const int* it = first_ordinal; it != last_ordinal; ++it) {
+            if (!IsFrozenRemoved(*it) && frozen_.Contains(*it)) {
+                removed.push_back(*it);
+            }
+        }
+        vector<int> frozen_removed;
+        frozen_removed.reserve(frozen_removed_.size() + removed.size());
+        merge(frozen_removed_.begin(), frozen_removed_.end(), removed.begin(), removed.end(), back_inserter(frozen_removed));
+        frozen_removed_ = move(frozen_removed);
+        return;
+    }
+
+    vector<Posting> postings;
+    postings.reserve(frozen_.size() - frozen_removed_.size());
+    const int* removed_it = first_ordinal;
+    auto keep_posting = [&](const Posting& posting) {
+        while (removed_it != last_ordinal && *removed_it < posting.ordinal) {
+            ++removed_it;
+        }
+        if (removed_it == last_ordinal || *removed_it != posting.ordinal) {
+            postings.push_back(posting);
+        }
+    };
+    ForEachFrozen(0, frozen_.GetLastOrdinal() + 1, keep_posting);
+    frozen_ = CompressedPostings(postings);
+    frozen_removed_.clear();
+}
+
+void PostingList::Merge()
+{
+    if (removed_count_ > 0) {
+        postings_.erase(remove_if(postings_.begin(), postings_.end(), [](const Posting& posting) {
+            return posting.term_freq == 0.0;
+        }), postings_.end());
+        removed_count_ = 0;
+    }
+    if (!delta_.empty()) {
+        sort(delta_.begin(), delta_.end(), IsLessByOrdinal);
+        const size_t old_size = postings_.size();
+        postings_.insert(postings_.end(), delta_.begin(), delta_.end());
+        inplace_merge(postings_.begin(), postings_.begin() + old_size, postings_.end(), IsLessByOrdinal);
+        delta_.clear();
+    }
+    RebuildBlocks();
+}
+
+void PostingList::Freeze()
+{
+    vector<Posting> postings;
+    postings.reserve(size());
+    ForEach([&postings](const Posting& posting) {
+        postings.push_back(posting);
+    });
+    if (!IsMerged()) {
+        sort(postings.begin(), postings.end(), IsLessByOrdinal);
+    }
+
+    frozen_ = CompressedPostings(postings);
+    frozen_removed_.clear();
+    postings_.clear();
+    postings_.shrink_to_fit();
+    delta_.clear();
+    delta_.shrink_to_fit();
+    removed_count_ = 0;
+    RebuildBlocks();
+}
+
+bool PostingList::Contains(int ordinal) const
+{
+    auto it = FindPosting(ordinal);
+    if (it != postings_.end()) {
+        return it->term_freq != 0.0;
+    }
+    if (any_of(delta_.begin(), delta_.end(), [ordinal](const Posting& posting) {
+        return posting.ordinal == ordinal;
+    })) {
+        return true;
+    }
+    return ordinal <= frozen_.GetLastOrdinal() && !IsFrozenRemoved(ordinal) && frozen_.Contains(ordinal);
+}
+
+size_t PostingList::size() const
+{
+    return frozen_.size() - frozen_removed_.size() + postings_.size() - removed_count_ + delta_.size();
+}
+
+bool PostingList::empty() const
+{
+    return size() == 0;
+}
+
+size_t PostingList::GetMemoryUsage() const
+{
+    return sizeof(PostingList) + frozen_.GetMemoryUsage()
+        + frozen_removed_.capacity() * sizeof(int)
+        + (postings_.capacity() + delta_.capacity()) * sizeof(Posting)
+        + block_last_ordinals_.capacity() * sizeof(int)
+        + block_max_term_freqs_.capacity() * sizeof(double);
+}
+
+bool PostingList::IsMerged() const
+{
+    return delta_.empty() && (postings_.empty() || postings_.front().ordinal > frozen_.GetLastOrdinal());
+}
+
+double PostingList::GetMaxTermFreq() const
+{
+    return max_term_freq_;
+}
+
+bool PostingList::IsFrozenRemoved(int ordinal) const
+{
+    return binary_search(frozen_removed_.begin(), frozen_removed_.end(), ordinal);
+}
+
+void PostingList::UpdateBlock(size_t position)
+{
+    const size_t block = position / block_size_;
+    if (block == block_last_ordinals_.size()) {
+        block_last_ordinals_.push_back(postings_[position].ordinal);
+        block_max_term_freqs_.push_back(postings_[position].term_freq);
+        return;
+    }
+    block_last_ordinals_[block] = max(block_last_ordinals_[block], postings_[position].ordinal);
+    block_max_term_freqs_[block] = max(block_max_term_freqs_[block], postings_[position].term_freq);
+}
+
+void PostingList::RebuildBlocks()
+{
+    block_last_ordinals_.clear();
+    block_max_term_freqs_.clear();
+    max_term_freq_ = frozen_.GetMaxTermFreq();
+    for (size_t position = 0; position < postings_.size(); ++position) {
+        UpdateBlock(position);
+        max_term_freq_ = max(max_term_freq_, postings_[position].term_freq);
+    }
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+    : postings_(&postings)
+{
+    if (!postings_->frozen_.empty()) {
+        LoadFrozenBlock(0);
+    }
+    SkipRemoved();
+}
+
+bool PostingList::Cursor::IsEnd() const
+{
+    return !in_frozen_ && position_ == postings_->postings_.size();
+}
+
+const Posting& PostingList::Cursor::operator*() const
+{
+    return in_frozen_ ? buffer_[buffer_position_] : postings_->postings_[position_];
+}
+
+const Posting* PostingList::Cursor::operator->() const
+{
+    return &**this;
+}
+
+void PostingList::Cursor::Next()
+{
+    if (in_frozen_) {
+        ++buffer_position_;
+    }
+    else {
+        ++position_;
+    }
+    SkipRemoved();
+}
+
+void PostingList::Cursor::Seek(int ordinal)
+{
+    if (IsEnd() || (*this)->ordinal >= ordinal) {
+        return;
+    }
+    const CompressedPostings& frozen = postings_->frozen_;
+    if (in_frozen_) {
+        if (ordinal > frozen.GetLastOrdinal()) {
+            in_frozen_ = false;
+        }
+        else {
+            const size_t block = frozen.FindBlock(ordinal, frozen_block_);
+            if (block != frozen_block_) {
+                LoadFrozenBlock(block);
+            }
+            buffer_position_ = lower_bound(buffer_ + buffer_position_, buffer_ + buffer_size_, Posting{ ordinal, 0.0 }, IsLessByOrdinal) - buffer_;
+            SkipRemoved();
+            return;
+        }
+    }
+
+    const auto& postings = postings_->postings_;
+    block_ = FindBlock(ordinal);
+    if (block_ == postings_->block_last_ordinals_.size()) {
+        position_ = postings.size();
+        return;
+    }
+    const auto first = postings.begin() + max(position_, block_ * block_size_);
+    const auto last = postings.begin() + min(postings.size(), (block_ + 1) * block_size_);
+    position_ = lower_bound(first, last, Posting{ ordinal, 0.0 }, IsLessByOrdinal) - postings.begin();
+    SkipRemoved();
+}
+
+double PostingList::Cursor::GetBlockMaxTermFreq(int ordinal)
+{
+    const CompressedPostings& frozen = postings_->frozen_;
+    if (ordinal <= frozen.GetLastOrdinal()) {
+        frozen_peek_block_ = frozen.FindBlock(ordinal, frozen_peek_block_);
+        return frozen.GetBlockMaxTermFreq(frozen_peek_block_);
+    }
+    block_ = FindBlock(ordinal);
+    if (block_ == postings_->block_max_term_freqs_.size()) {
+        return 0.0;
+    }
+    return postings_->block_max_term_freqs_[block_];
+}
+
+void PostingList::Cursor::LoadFrozenBlock(size_t block)
+{
+    const CompressedPostings& frozen = postings_->frozen_;
+    in_frozen_ = block < frozen.GetBlockCount();
+    if (in_frozen_) {
+        frozen_block_ = block;
+        buffer_size_ = frozen.DecodeBlock(block, buffer_);
+        buffer_position_ = 0;
+    }
+}
+
+void PostingList::Cursor::SkipRemoved()
+{
+    const auto& removed = postings_->frozen_removed_;
+    while (in_frozen_) {
+        if (buffer_position_ == buffer_size_) {
+            LoadFrozenBlock(frozen_block_ + 1);
+            continue;
+        }
+        const int ordinal = buffer_[buffer_position_].ordinal;
+        while (removed_position_ < removed.size() && removed[removed_position_] < ordinal) {
+            ++removed_position_;
+        }
+        if (removed_position_ == removed.size() || removed[removed_position_] != ordinal) {
+            return;
+        }
+        ++buffer_position_;
+    }
+
+    const auto& postings = postings_->postings_;
+    while (position_ < postings.size() && postings[position_].term_freq == 0.0) {
+        ++position_;
+    }
+}
+
+size_t PostingList::Cursor::FindBlock(int ordinal) const
+{
+    const auto& last_ordinals = postings_->block_last_ordinals_;
+    return lower_bound(last_ordinals.begin() + block_, last_ordinals.end(), ordinal) - last_ordinals.begin();
+}
+
+vector<Posting>::iterator PostingList::FindPosting(int ordinal)
+{
+    auto it = lower_bound(postings_.begin(), postings_.end(), Posting{ ordinal, 0.0 }, IsLessByOrdinal);
+    return (it != postings_.end() && it->ordinal == ordinal) ? it : postings_.end();
+}
+
+vector<Posting>::const_iterator PostingList::FindPosting(int ordinal) const
+{
+    auto it = lower_bound(postings_.begin(), postings_.end(), Posting{ ordinal, 0.0 }, IsLessByOrdinal);
+    return (it != postings_.end() && it->ordinal == ordinal) ? it : postings_.end();
+}
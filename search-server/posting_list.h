@@ -0,0 +1,173 @@
+#pragma once
+
+#include "compressed_postings.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Список документов одного слова: сжатая неизменяемая часть (после Freeze),
+// за ней отсортированный по порядковому номеру документа массив
+// и небольшой буфер вставок вне порядка, который периодически сливается
+class PostingList {
+public:
+    PostingList() = default;
+    // Список из уже сжатых документов, например из снимка индекса
+    explicit PostingList(CompressedPostings frozen);
+
+    void Add(int ordinal, double term_freq);
+    void Remove(int ordinal);
+    // Удаляет документы с номерами из [first_ordinal, last_ordinal), номера по возрастанию.
+    // Каждая часть списка переписывается за один проход, буфер вставок сливается
+    void Remove(const int* first_ordinal, const int* last_ordinal);
+    void Merge();
+    // Сжимает весь список
+    void Freeze();
+
+    bool Contains(int ordinal) const;
+    size_t size() const;
+    bool empty() const;
+    size_t GetMemoryUsage() const;
+
+    // Обходит живые документы; пока буфер не слит, порядок номеров не гарантирован
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    // Обходит живые документы с номерами из [first_ordinal, last_ordinal)
+    template <typename Function>
+    void ForEachInRange(int first_ordinal, int last_ordinal, Function function) const;
+
+    // Список можно обходить курсором по возрастанию номеров
+    bool IsMerged() const;
+
+    // Оценка сверху term_freq по всему списку; после удалений может быть завышена
+    double GetMaxTermFreq() const;
+
+    // Курсор по слитому списку с пропуском блоков при поиске
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& postings);
+
+        bool IsEnd() const;
+        const Posting& operator*() const;
+        const Posting* operator->() const;
+
+        void Next();
+        // Переходит к первому живому документу с номером не меньше ordinal
+        void Seek(int ordinal);
+        // Оценка сверху term_freq в блоке, где мог бы находиться ordinal.
+        // Номера в последовательных вызовах не должны убывать
+        double GetBlockMaxTermFreq(int ordinal);
+
+    private:
+        const PostingList* postings_;
+
+        // сжатая часть: текущий распакованный блок
+        bool in_frozen_ = false;
+        size_t frozen_block_ = 0;
+        size_t frozen_peek_block_ = 0;
+        size_t buffer_size_ = 0;
+        size_t buffer_position_ = 0;
+        size_t removed_position_ = 0;
+        Posting buffer_[CompressedPostings::block_size];
+
+        // несжатая часть
+        size_t position_ = 0;
+        size_t block_ = 0;
+
+        void LoadFrozenBlock(size_t block);
+        void SkipRemoved();
+        size_t FindBlock(int ordinal) const;
+    };
+
+private:
+    static constexpr size_t min_merge_size_ = 64;
+    static constexpr size_t block_size_ = 64;
+
+    CompressedPostings frozen_;
+    // номера, удалённые из сжатой части, по возрастанию
+    std::vector<int> frozen_removed_;
+
+    // удалённые документы остаются в postings_ с term_freq == 0 до слияния
+    std::vector<Posting> postings_;
+    std::vector<Posting> delta_;
+    size_t removed_count_ = 0;
+
+    // по блокам из block_size_ документов postings_
+    std::vector<int> block_last_ordinals_;
+    std::vector<double> block_max_term_freqs_;
+    double max_term_freq_ = 0.0;
+
+    std::vector<Posting>::iterator FindPosting(int ordinal);
+    std::vector<Posting>::const_iterator FindPosting(int ordinal) const;
+    bool IsFrozenRemoved(int ordinal) const;
+    void RemoveFrozen(const int* first_ordinal, const int* last_ordinal);
+
+    void UpdateBlock(size_t position);
+    void RebuildBlocks();
+
+    template <typename Function>
+    void ForEachFrozen(int first_ordinal, int last_ordinal, Function& function) const;
+};
+
+template <typename Function>
+void PostingList::ForEachFrozen(int first_ordinal, int last_ordinal, Function& function) const
+{
+    if (frozen_.empty() || first_ordinal > frozen_.GetLastOrdinal()) {
+        return;
+    }
+    auto removed_it = std::lower_bound(frozen_removed_.begin(), frozen_removed_.end(), first_ordinal);
+    Posting buffer[CompressedPostings::block_size];
+    for (size_t block = frozen_.FindBlock(first_ordinal); block < frozen_.GetBlockCount(); ++block) {
+        const size_t count = frozen_.DecodeBlock(block, buffer);
+        for (size_t i = 0; i < count; ++i) {
+            const Posting& posting = buffer[i];
+            if (posting.ordinal < first_ordinal) {
+                continue;
+            }
+            if (posting.ordinal >= last_ordinal) {
+                return;
+            }
+            while (removed_it != frozen_removed_.end() && *removed_it < posting.ordinal) {
+                ++removed_it;
+            }
+            if (removed_it == frozen_removed_.end() || *removed_it != posting.ordinal) {
+                function(posting);
+            }
+        }
+    }
+}
+
+template <typename Function>
+void PostingList::ForEach(Function function) const
+{
+    ForEachFrozen(0, frozen_.GetLastOrdinal() + 1, function);
+    for (const Posting& posting : postings_) {
+        if (posting.term_freq != 0.0) {
+            function(posting);
+        }
+    }
+    for (const Posting& posting : delta_) {
+        function(posting);
+    }
+}
+
+template <typename Function>
+void PostingList::ForEachInRange(int first_ordinal, int last_ordinal, Function function) const
+{
+    ForEachFrozen(first_ordinal, last_ordinal, function);
+    const auto by_ordinal = [](const Posting& posting, int ordinal) {
+        return posting.ordinal < ordinal;
+    };
+    auto it = std::lower_bound(postings_.begin(), postings_.end(), first_ordinal, by_ordinal);
+    for (; it != postings_.end() && it->ordinal < last_ordinal; ++it) {
+        if (it->term_freq != 0.0) {
+            function(*it);
+        }
+    }
+    for (const Posting& posting : delta_) {
+        if (posting.ordinal >= first_ordinal && posting.ordinal < last_ordinal) {
+            function(posting);
+        }
+    }
+}
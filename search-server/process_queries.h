@@ -1,4 +1,12 @@
 #pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 #include "document.h"
 #include "search_server.h"
@@ -11,4 +19,98 @@ std::vector<std::vector<Document>> ProcessQueries(
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+
+// Ленивый ProcessQueriesJoined: документы выдаются в том же порядке, по мере
+// готовности запросов. Рабочие потоки выполняют запросы не дальше max_in_flight
+// от первого невыданного, поэтому память пропорциональна max_in_flight,
+// а не числу запросов. Сервер и запросы должны жить, пока жив поток результатов
+class QueryResultStream {
+public:
+    QueryResultStream(const SearchServer& search_server, const std::vector<std::string>& queries, size_t max_in_flight);
+    ~QueryResultStream();
+
+    QueryResultStream(const QueryResultStream&) = delete;
+    QueryResultStream& operator=(const QueryResultStream&) = delete;
+
+    // false, если документов больше нет. Исключение запроса бросается,
+    // когда до него доходит очередь
+    bool Next(Document& document);
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+
+        Iterator() = default;
+        explicit Iterator(QueryResultStream* stream);
+
+        const Document& operator*() const
+        {
+            return document_;
+        }
+
+        const Document* operator->() const
+        {
+            return &document_;
+        }
+
+        Iterator& operator++();
+
+        bool operator==(const Iterator& other) const
+        {
+            return stream_ == other.stream_;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        // nullptr у конца
+        QueryResultStream* stream_ = nullptr;
+        Document document_;
+    };
+
+    // Поток проходится один раз
+    Iterator begin();
+    Iterator end();
+
+private:
+    struct Slot
+    {
+        std::vector<Document> documents;
+        std::exception_ptr error;
+        bool is_ready = false;
+    };
+
+    const SearchServer& search_server_;
+    const std::vector<std::string>& queries_;
+
+    std::mutex mutex_;
+    std::condition_variable result_ready_;
+    std::condition_variable window_moved_;
+    // результат запроса i лежит в slots_[i % slots_.size()]
+    std::vector<Slot> slots_;
+    size_t next_query_ = 0;
+    size_t next_result_ = 0;
+    bool is_stopping_ = false;
+
+    // документы выдаваемого запроса, только для читателя
+    std::vector<Document> documents_;
+    size_t document_position_ = 0;
+
+    std::vector<std::thread> workers_;
+
+    void RunWorker();
+};
+
+QueryResultStream ProcessQueriesJoinedLazy(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    size_t max_in_flight = 2 * std::max(1u, std::thread::hardware_concurrency()));
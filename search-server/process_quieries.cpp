@@ -1,39 +1,123 @@
 #include "process_queries.h"
-#include <execution>
-#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> documents_lists(queries.size());    
-    std::transform(std::execution::par, queries.begin(), queries.end(), documents_lists.begin(),
-        [&search_server](const std::string& query) { 
-            return search_server.FindTopDocuments(query); 
-        });
-
+    const QueryBatchResults results = search_server.FindTopDocumentsBatch(queries);
+    std::vector<std::vector<Document>> documents_lists(results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        documents_lists[i].assign(results[i].begin(), results[i].end());
+    }
     return documents_lists;
 }
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> documents_lists(queries.size());    
-    std::transform(std::execution::par, queries.begin(), queries.end(), documents_lists.begin(),
-        [&search_server](const std::string& query) { 
-            return search_server.FindTopDocuments(query); 
+    // документы пакета уже лежат подряд в порядке запросов
+    return search_server.FindTopDocumentsBatch(queries).ReleaseDocuments();
+}
+
+QueryResultStream::QueryResultStream(const SearchServer& search_server, const std::vector<std::string>& queries, size_t max_in_flight)
+    : search_server_(search_server)
+    , queries_(queries)
+    , slots_(max_in_flight)
+{
+    if (max_in_flight == 0) {
+        throw std::invalid_argument("Query window must not be empty");
+    }
+    const size_t worker_count = std::min({ max_in_flight, queries.size(), size_t{ std::max(1u, std::thread::hardware_concurrency()) } });
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this] {
+            RunWorker();
         });
+    }
+}
 
-    size_t size = 0;
-    for (const auto& documents_list : documents_lists) {
-        size += documents_list.size();
+QueryResultStream::~QueryResultStream() {
+    {
+        std::lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    window_moved_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
     }
+}
 
-    std::vector<Document> result;
-    result.reserve(size);
-    auto it_begin = result.begin();
-    for (auto& documents_list : documents_lists) {
-        result.resize(result.size() + documents_list.size());
-        it_begin = std::transform(std::make_move_iterator(documents_list.begin()), std::make_move_iterator(documents_list.end()), it_begin,
-            [](const Document& value) { 
-                return value;
-            });
+bool QueryResultStream::Next(Document& document) {
+    while (document_position_ == documents_.size()) {
+        std::unique_lock lock(mutex_);
+        if (next_result_ == queries_.size()) {
+            return false;
+        }
+        Slot& slot = slots_[next_result_ % slots_.size()];
+        result_ready_.wait(lock, [&slot] {
+            return slot.is_ready;
+        });
+        documents_ = std::move(slot.documents);
+        document_position_ = 0;
+        const std::exception_ptr error = slot.error;
+        slot = Slot();
+        ++next_result_;
+        lock.unlock();
+        window_moved_.notify_all();
+        if (error) {
+            std::rethrow_exception(error);
+        }
     }
+    document = documents_[document_position_++];
+    return true;
+}
+
+void QueryResultStream::RunWorker() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        window_moved_.wait(lock, [this] {
+            return is_stopping_ || next_query_ == queries_.size() || next_query_ < next_result_ + slots_.size();
+        });
+        if (is_stopping_ || next_query_ == queries_.size()) {
+            return;
+        }
+        const size_t query_index = next_query_++;
+        lock.unlock();
+
+        Slot result;
+        try {
+            result.documents = search_server_.FindTopDocuments(queries_[query_index]);
+        }
+        catch (...) {
+            result.error = std::current_exception();
+        }
+        result.is_ready = true;
+
+        lock.lock();
+        slots_[query_index % slots_.size()] = std::move(result);
+        result_ready_.notify_one();
+    }
+}
+
+QueryResultStream::Iterator::Iterator(QueryResultStream* stream)
+    : stream_(stream)
+{
+    ++*this;
+}
+
+QueryResultStream::Iterator& QueryResultStream::Iterator::operator++() {
+    if (!stream_->Next(document_)) {
+        stream_ = nullptr;
+    }
+    return *this;
+}
+
+QueryResultStream::Iterator QueryResultStream::begin() {
+    return Iterator(this);
+}
+
+QueryResultStream::Iterator QueryResultStream::end() {
+    return Iterator();
+}
 
-    return result;
+QueryResultStream ProcessQueriesJoinedLazy(const SearchServer& search_server, const std::vector<std::string>& queries, size_t max_in_flight) {
+    return QueryResultStream(search_server, queries, max_in_flight);
 }
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "document.h"
+#include "paginator.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Результаты пакета запросов в одном массиве: документы запроса i лежат
+// в [offsets[i], offsets[i + 1]) в порядке убывания релевантности
+class QueryBatchResults {
+public:
+    using Range = IteratorRange<std::vector<Document>::const_iterator>;
+
+    QueryBatchResults() = default;
+    // offsets на один элемент длиннее числа запросов, последний равен documents.size()
+    QueryBatchResults(std::vector<Document> documents, std::vector<size_t> offsets)
+        : documents_(std::move(documents))
+        , offsets_(std::move(offsets))
+    {
+    }
+
+    // Число запросов
+    size_t size() const
+    {
+        return offsets_.empty() ? 0 : offsets_.size() - 1;
+    }
+
+    Range operator[](size_t query_index) const
+    {
+        return Range(documents_.begin() + offsets_[query_index], documents_.begin() + offsets_[query_index + 1]);
+    }
+
+    // Документы всех запросов подряд
+    const std::vector<Document>& GetDocuments() const
+    {
+        return documents_;
+    }
+
+    const std::vector<size_t>& GetOffsets() const
+    {
+        return offsets_;
+    }
+
+    // Забирает документы всех запросов без копирования
+    std::vector<Document> ReleaseDocuments()
+    {
+        offsets_.assign(offsets_.size(), 0);
+        return std::move(documents_);
+    }
+
+private:
+    std::vector<Document> documents_;
+    std::vector<size_t> offsets_;
+};
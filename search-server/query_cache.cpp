@@ -0,0 +1,78 @@
+#include "query_cache.h"
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+QueryResultCache::QueryResultCache(size_t capacity, size_t shard_count)
+    : shard_capacity_(shard_count == 0 ? 0 : (capacity + shard_count - 1) / shard_count)
+    , shards_(shard_count)
+{
+    if (capacity == 0 || shard_count == 0) {
+        throw invalid_argument("Query cache capacity and shard count must be positive");
+    }
+}
+
+optional<vector<Document>> QueryResultCache::Find(const string& key, uint64_t version)
+{
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.positions.find(key);
+    if (it == shard.positions.end()) {
+        ++shard.stats.misses;
+        return nullopt;
+    }
+    if (it->second->version != version) {
+        ++shard.stats.misses;
+        ++shard.stats.invalidations;
+        shard.entries.erase(it->second);
+        shard.positions.erase(it);
+        return nullopt;
+    }
+    ++shard.stats.hits;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return shard.entries.front().documents;
+}
+
+void QueryResultCache::Insert(string key, uint64_t version, const vector<Document>& documents)
+{
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.positions.find(key);
+    if (it != shard.positions.end()) {
+        // тот же запрос мог посчитать другой поток
+        it->second->version = version;
+        it->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+
+    if (shard.entries.size() == shard_capacity_) {
+        shard.positions.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+        ++shard.stats.evictions;
+    }
+    shard.entries.push_front({ move(key), version, documents });
+    shard.positions.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+QueryCacheStats QueryResultCache::GetStats() const
+{
+    QueryCacheStats stats;
+    for (const Shard& shard : shards_) {
+        lock_guard lock(shard.mutex);
+        stats.hits += shard.stats.hits;
+        stats.misses += shard.stats.misses;
+        stats.invalidations += shard.stats.invalidations;
+        stats.evictions += shard.stats.evictions;
+        stats.size += shard.entries.size();
+    }
+    return stats;
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const string& key)
+{
+    return shards_[hash<string>{}(key) % shards_.size()];
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // промахи из-за того, что результат посчитан для другой версии индекса
+    uint64_t invalidations = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+};
+
+// Кэш результатов поиска по ключу запроса. Разделён на части со своими
+// мьютексами, в каждой вытесняется результат, к которому дольше всего не
+// обращались. Результат, посчитанный при другой версии индекса, считается
+// устаревшим и удаляется при обращении к нему
+class QueryResultCache {
+public:
+    // Бросает invalid_argument, если capacity или shard_count равны нулю
+    QueryResultCache(size_t capacity, size_t shard_count);
+
+    std::optional<std::vector<Document>> Find(const std::string& key, uint64_t version);
+    void Insert(std::string key, uint64_t version, const std::vector<Document>& documents);
+
+    QueryCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t version;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // от недавно использованных к давно использованным
+        std::list<Entry> entries;
+        // ключи указывают в entries
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> positions;
+        QueryCacheStats stats;
+    };
+
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+
+    Shard& GetShard(const std::string& key);
+};
@@ -0,0 +1,287 @@
+#include "query_metrics.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+namespace {
+
+int64_t ToNanoseconds(QueryMetrics::Clock::time_point time)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+// Небольшой номер потока для трассировки
+uint32_t GetTraceThreadId()
+{
+    static atomic<uint32_t> next_thread_id{ 1 };
+    thread_local const uint32_t thread_id = next_thread_id++;
+    return thread_id;
+}
+
+int GetHighestBit(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+} // namespace
+
+string_view GetQueryStageName(QueryStage stage)
+{
+    switch (stage) {
+    case QueryStage::PARSE_QUERY:
+        return "parse_query";
+    case QueryStage::MINUS_FILTERING:
+        return "minus_filtering";
+    case QueryStage::POSTING_TRAVERSAL:
+        return "posting_traversal";
+    case QueryStage::SCORE_COLLECTION:
+        return "score_collection";
+    case QueryStage::TOP_K:
+        return "top_k";
+    default:
+        return "unknown";
+    }
+}
+
+string_view GetQueryCounterName(QueryCounter counter)
+{
+    switch (counter) {
+    case QueryCounter::POSTINGS_VISITED:
+        return "postings_visited";
+    case QueryCounter::PREDICATE_REJECTIONS:
+        return "predicate_rejections";
+    case QueryCounter::CANDIDATES_SCORED:
+        return "candidates_scored";
+    default:
+        return "unknown";
+    }
+}
+
+DurationHistogram::DurationHistogram(const DurationHistogram& other)
+{
+    Add(other);
+}
+
+void DurationHistogram::Record(uint64_t nanoseconds)
+{
+    counts_[GetBucket(nanoseconds)].fetch_add(1, memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+    sum_.fetch_add(nanoseconds, memory_order_relaxed);
+}
+
+void DurationHistogram::Add(const DurationHistogram& other)
+{
+    for (size_t bucket = 0; bucket < bucket_count_; ++bucket) {
+        counts_[bucket].fetch_add(other.counts_[bucket].load(memory_order_relaxed), memory_order_relaxed);
+    }
+    count_.fetch_add(other.count_.load(memory_order_relaxed), memory_order_relaxed);
+    sum_.fetch_add(other.sum_.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+void DurationHistogram::Reset()
+{
+    for (auto& count : counts_) {
+        count.store(0, memory_order_relaxed);
+    }
+    count_.store(0, memory_order_relaxed);
+    sum_.store(0, memory_order_relaxed);
+}
+
+uint64_t DurationHistogram::GetCount() const
+{
+    return count_.load(memory_order_relaxed);
+}
+
+uint64_t DurationHistogram::GetSum() const
+{
+    return sum_.load(memory_order_relaxed);
+}
+
+uint64_t DurationHistogram::CountAtOrBelow(uint64_t value) const
+{
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket + 1 < bucket_count_ && GetBucketLowerBound(bucket + 1) <= value; ++bucket) {
+        count += counts_[bucket].load(memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t DurationHistogram::GetQuantile(double quantile) const
+{
+    // общее число берётся по корзинам, чтобы не расходиться с ними при одновременной записи
+    array<uint64_t, bucket_count_> counts;
+    uint64_t total = 0;
+    for (size_t bucket = 0; bucket < bucket_count_; ++bucket) {
+        counts[bucket] = counts_[bucket].load(memory_order_relaxed);
+        total += counts[bucket];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(clamp(quantile, 0.0, 1.0) * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket + 1 < bucket_count_; ++bucket) {
+        seen += counts[bucket];
+        if (seen >= rank) {
+            return GetBucketLowerBound(bucket + 1);
+        }
+    }
+    return max_value;
+}
+
+size_t DurationHistogram::GetBucket(uint64_t value)
+{
+    // корзина bucket хранит значения из (GetBucketLowerBound(bucket), GetBucketLowerBound(bucket + 1)],
+    // нулевая - ещё и 0
+    value = min(value, max_value);
+    value = value > 0 ? value - 1 : 0;
+    // значения меньше 2 * sub_bucket_count_ получают по своей корзине
+    if (value < 2 * sub_bucket_count_) {
+        return static_cast<size_t>(value);
+    }
+    const int shift = GetHighestBit(value) - sub_bucket_bits_;
+    return static_cast<size_t>(shift) * sub_bucket_count_ + static_cast<size_t>(value >> shift);
+}
+
+uint64_t DurationHistogram::GetBucketLowerBound(size_t bucket)
+{
+    if (bucket < 2 * sub_bucket_count_) {
+        return bucket;
+    }
+    const size_t shift = bucket / sub_bucket_count_ - 1;
+    return static_cast<uint64_t>(bucket % sub_bucket_count_ + sub_bucket_count_) << shift;
+}
+
+QueryMetrics::QueryMetrics()
+    : trace_events_(trace_capacity_)
+{
+}
+
+QueryMetrics& QueryMetrics::Global()
+{
+    static QueryMetrics metrics;
+    return metrics;
+}
+
+void QueryMetrics::RecordStage(QueryStage stage, Clock::time_point start, Clock::time_point finish)
+{
+    const int64_t duration_ns = chrono::duration_cast<chrono::nanoseconds>(finish - start).count();
+    stages_[static_cast<size_t>(stage)].Record(static_cast<uint64_t>(max<int64_t>(duration_ns, 0)));
+    if (!is_tracing_.load(memory_order_relaxed)) {
+        return;
+    }
+    const size_t index = next_trace_event_.fetch_add(1, memory_order_relaxed);
+    if (index >= trace_capacity_) {
+        return;
+    }
+    TraceEvent& event = trace_events_[index];
+    event.stage.store(static_cast<int>(stage), memory_order_relaxed);
+    event.thread.store(GetTraceThreadId(), memory_order_relaxed);
+    event.start_ns.store(ToNanoseconds(start), memory_order_relaxed);
+    event.duration_ns.store(duration_ns, memory_order_relaxed);
+    event.trace.store(trace_.load(memory_order_relaxed), memory_order_release);
+}
+
+void QueryMetrics::Add(QueryCounter counter, uint64_t value)
+{
+    counters_[static_cast<size_t>(counter)].fetch_add(value, memory_order_relaxed);
+}
+
+const DurationHistogram& QueryMetrics::GetStageHistogram(QueryStage stage) const
+{
+    return stages_[static_cast<size_t>(stage)];
+}
+
+uint64_t QueryMetrics::GetCounter(QueryCounter counter) const
+{
+    return counters_[static_cast<size_t>(counter)].load(memory_order_relaxed);
+}
+
+void QueryMetrics::Reset()
+{
+    for (DurationHistogram& histogram : stages_) {
+        histogram.Reset();
+    }
+    for (auto& counter : counters_) {
+        counter.store(0, memory_order_relaxed);
+    }
+}
+
+void QueryMetrics::StartTrace()
+{
+    is_tracing_.store(false, memory_order_relaxed);
+    trace_.fetch_add(1, memory_order_relaxed);
+    trace_start_ns_.store(ToNanoseconds(Clock::now()), memory_order_relaxed);
+    next_trace_event_.store(0, memory_order_relaxed);
+    is_tracing_.store(true, memory_order_release);
+}
+
+void QueryMetrics::StopTrace()
+{
+    is_tracing_.store(false, memory_order_relaxed);
+}
+
+void QueryMetrics::WritePrometheus(ostream& output) const
+{
+    constexpr int first_bound_bit = 7;
+    constexpr int last_bound_bit = 36;
+    const auto old_precision = output.precision(9);
+
+    output << "# HELP search_server_query_stage_seconds Duration of FindTopDocuments stages.\n"
+           << "# TYPE search_server_query_stage_seconds histogram\n";
+    for (size_t stage = 0; stage < stages_.size(); ++stage) {
+        const DurationHistogram& histogram = stages_[stage];
+        const string_view name = GetQueryStageName(static_cast<QueryStage>(stage));
+        for (int bit = first_bound_bit; bit <= last_bound_bit; ++bit) {
+            const uint64_t bound = uint64_t{ 1 } << bit;
+            output << "search_server_query_stage_seconds_bucket{stage=\"" << name << "\",le=\"" << bound * 1e-9 << "\"} "
+                   << histogram.CountAtOrBelow(bound) << '\n';
+        }
+        output << "search_server_query_stage_seconds_bucket{stage=\"" << name << "\",le=\"+Inf\"} " << histogram.GetCount() << '\n'
+               << "search_server_query_stage_seconds_sum{stage=\"" << name << "\"} " << histogram.GetSum() * 1e-9 << '\n'
+               << "search_server_query_stage_seconds_count{stage=\"" << name << "\"} " << histogram.GetCount() << '\n';
+    }
+
+    for (size_t counter = 0; counter < counters_.size(); ++counter) {
+        const string_view name = GetQueryCounterName(static_cast<QueryCounter>(counter));
+        output << "# TYPE search_server_query_" << name << "_total counter\n"
+               << "search_server_query_" << name << "_total " << counters_[counter].load(memory_order_relaxed) << '\n';
+    }
+    output.precision(old_precision);
+}
+
+void QueryMetrics::WriteChromeTrace(ostream& output) const
+{
+    const uint64_t trace = trace_.load(memory_order_relaxed);
+    const int64_t trace_start_ns = trace_start_ns_.load(memory_order_relaxed);
+    const size_t event_count = min(next_trace_event_.load(memory_order_relaxed), trace_capacity_);
+    const auto old_flags = output.flags();
+    const auto old_precision = output.precision(3);
+    output << fixed << "{\"traceEvents\":[";
+    bool is_first = true;
+    for (size_t index = 0; index < event_count; ++index) {
+        const TraceEvent& event = trace_events_[index];
+        if (event.trace.load(memory_order_acquire) != trace) {
+            continue;
+        }
+        output << (is_first ? "\n" : ",\n")
+               << "{\"name\":\"" << GetQueryStageName(static_cast<QueryStage>(event.stage.load(memory_order_relaxed)))
+               << "\",\"cat\":\"query\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread.load(memory_order_relaxed)
+               << ",\"ts\":" << (event.start_ns.load(memory_order_relaxed) - trace_start_ns) / 1000.0
+               << ",\"dur\":" << event.duration_ns.load(memory_order_relaxed) / 1000.0 << '}';
+        is_first = false;
+    }
+    output << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    output.flags(old_flags);
+    output.precision(old_precision);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "log_duration.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Этапы поиска FindTopDocuments. Предикат проверяется во время обхода списков,
+// поэтому его время входит в POSTING_TRAVERSAL, а отсеянные им документы
+// видны по счётчику PREDICATE_REJECTIONS
+enum class QueryStage {
+    PARSE_QUERY,
+    MINUS_FILTERING,
+    POSTING_TRAVERSAL,
+    SCORE_COLLECTION,
+    TOP_K,
+    COUNT,
+};
+
+enum class QueryCounter {
+    POSTINGS_VISITED,
+    PREDICATE_REJECTIONS,
+    CANDIDATES_SCORED,
+    COUNT,
+};
+
+std::string_view GetQueryStageName(QueryStage stage);
+std::string_view GetQueryCounterName(QueryCounter counter);
+
+// Гистограмма длительностей в наносекундах с корзинами как у HdrHistogram:
+// каждая степень двойки делится на 16 равных корзин, поэтому значение
+// восстанавливается с точностью до 1/16. Корзина включает верхнюю границу,
+// как le в Prometheus. Запись - fetch_add без блокировок
+class DurationHistogram {
+public:
+    // большие значения попадают в последнюю корзину
+    static constexpr uint64_t max_value = (uint64_t{ 1 } << 40) - 1;
+
+    DurationHistogram() = default;
+    // Копирует счётчики по одному; записи, идущие одновременно, могут попасть в копию частично
+    DurationHistogram(const DurationHistogram& other);
+    DurationHistogram& operator=(const DurationHistogram&) = delete;
+
+    void Record(uint64_t nanoseconds);
+    // Добавляет значения other
+    void Add(const DurationHistogram& other);
+    void Reset();
+
+    uint64_t GetCount() const;
+    uint64_t GetSum() const;
+    // Число значений не больше value; для степеней двойки точное
+    uint64_t CountAtOrBelow(uint64_t value) const;
+    // Верхняя граница корзины, в которую попадает доля quantile значений; 0, если значений нет
+    uint64_t GetQuantile(double quantile) const;
+
+private:
+    static constexpr int sub_bucket_bits_ = 4;
+    static constexpr size_t sub_bucket_count_ = size_t{ 1 } << sub_bucket_bits_;
+    static constexpr size_t bucket_count_ = (40 - sub_bucket_bits_ + 1) * sub_bucket_count_;
+
+    std::array<std::atomic<uint64_t>, bucket_count_> counts_{};
+    std::atomic<uint64_t> count_{ 0 };
+    std::atomic<uint64_t> sum_{ 0 };
+
+    static size_t GetBucket(uint64_t value);
+    static uint64_t GetBucketLowerBound(size_t bucket);
+};
+
+// Метрики этапов всех запросов процесса. Запись не берёт блокировок;
+// события для Chrome trace пишутся в буфер фиксированного размера,
+// пока трассировка включена, лишние события отбрасываются
+class QueryMetrics {
+public:
+    using Clock = LogDuration::Clock;
+
+    static QueryMetrics& Global();
+
+    void RecordStage(QueryStage stage, Clock::time_point start, Clock::time_point finish);
+    void Add(QueryCounter counter, uint64_t value);
+
+    const DurationHistogram& GetStageHistogram(QueryStage stage) const;
+    uint64_t GetCounter(QueryCounter counter) const;
+    // Обнуляет гистограммы и счётчики; записи, идущие одновременно, могут сохраниться
+    void Reset();
+
+    // Начинает новую трассировку, события предыдущей отбрасываются
+    void StartTrace();
+    void StopTrace();
+
+    // Текстовый формат Prometheus: гистограммы этапов в секундах с границами
+    // по степеням двойки наносекунд и счётчики
+    void WritePrometheus(std::ostream& output) const;
+    // Формат Chrome trace (chrome://tracing, Perfetto): событие на каждый этап
+    void WriteChromeTrace(std::ostream& output) const;
+
+private:
+    static constexpr size_t trace_capacity_ = size_t{ 1 } << 16;
+
+    struct TraceEvent {
+        // номер трассировки, к которой относится событие; пишется последним
+        std::atomic<uint64_t> trace{ 0 };
+        std::atomic<int> stage{ 0 };
+        std::atomic<uint32_t> thread{ 0 };
+        std::atomic<int64_t> start_ns{ 0 };
+        std::atomic<int64_t> duration_ns{ 0 };
+    };
+
+    std::array<DurationHistogram, static_cast<size_t>(QueryStage::COUNT)> stages_;
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(QueryCounter::COUNT)> counters_{};
+
+    std::atomic<bool> is_tracing_{ false };
+    std::atomic<uint64_t> trace_{ 0 };
+    std::atomic<int64_t> trace_start_ns_{ 0 };
+    std::atomic<size_t> next_trace_event_{ 0 };
+    std::vector<TraceEvent> trace_events_;
+
+    QueryMetrics();
+};
+
+// Записывает этап от создания до выхода из области видимости
+class QueryStageTimer {
+public:
+    explicit QueryStageTimer(QueryStage stage)
+        : stage_(stage) {
+    }
+
+    QueryStageTimer(const QueryStageTimer&) = delete;
+    QueryStageTimer& operator=(const QueryStageTimer&) = delete;
+
+    ~QueryStageTimer() {
+        QueryMetrics::Global().RecordStage(stage_, start_time_, QueryMetrics::Clock::now());
+    }
+
+private:
+    const QueryStage stage_;
+    const QueryMetrics::Clock::time_point start_time_ = QueryMetrics::Clock::now();
+};
+
+// Замеры в коде поиска включаются определением SEARCH_SERVER_QUERY_METRICS,
+// без него макросы не оставляют в коде ничего, аргументы не вычисляются
+#ifdef SEARCH_SERVER_QUERY_METRICS
+#define QUERY_STAGE(stage) QueryStageTimer UNIQUE_VAR_NAME_PROFILE(stage)
+#define QUERY_COUNT(counter, value) QueryMetrics::Global().Add(counter, value)
+#else
+#define QUERY_STAGE(stage) static_cast<void>(0)
+#define QUERY_COUNT(counter, value) static_cast<void>(0)
+#endif
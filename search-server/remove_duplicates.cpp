@@ -0,0 +1,256 @@
+#include "remove_duplicates.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+using DocumentTerms = SearchServer::DocumentTerms;
+
+// Финализатор splitmix64
+uint64_t MixHash(uint64_t value, uint64_t seed)
+{
+    value += seed * 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+bool HaveSameTerms(const DocumentTerms& lhs, const DocumentTerms& rhs)
+{
+    return equal(lhs.term_ids, lhs.term_ids + lhs.size, rhs.term_ids, rhs.term_ids + rhs.size);
+}
+
+double ComputeJaccardSimilarity(const DocumentTerms& lhs, const DocumentTerms& rhs)
+{
+    size_t common_count = 0;
+    for (size_t i = 0, j = 0; i < lhs.size && j < rhs.size;) {
+        if (lhs.term_ids[i] < rhs.term_ids[j]) {
+            ++i;
+        }
+        else if (rhs.term_ids[j] < lhs.term_ids[i]) {
+            ++j;
+        }
+        else {
+            ++common_count;
+            ++i;
+            ++j;
+        }
+    }
+    const size_t union_count = lhs.size + rhs.size - common_count;
+    return union_count == 0 ? 1.0 : static_cast<double>(common_count) / union_count;
+}
+
+// Хеши слова для значений подписи MinHash
+struct TermHashes
+{
+    uint64_t first;
+    uint64_t second;
+};
+
+// Хеш полосы band подписи документа. Значение подписи - минимум по словам
+// документа хеша first + value * second
+uint64_t ComputeBandHash(const DocumentTerms& terms, const vector<TermHashes>& term_hashes, size_t band, size_t rows_per_band)
+{
+    vector<uint64_t> rows(rows_per_band, UINT64_MAX);
+    for (size_t i = 0; i < terms.size; ++i) {
+        const TermHashes& hashes = term_hashes[terms.term_ids[i]];
+        for (size_t row = 0; row < rows_per_band; ++row) {
+            rows[row] = min(rows[row], hashes.first + (band * rows_per_band + row) * hashes.second);
+        }
+    }
+    uint64_t band_hash = band;
+    for (const uint64_t row : rows) {
+        band_hash = MixHash(band_hash ^ row, 1);
+    }
+    return band_hash;
+}
+
+// Документ корзины полосы и предыдущий по индексу документ той же корзины
+struct BucketLink
+{
+    uint32_t index;
+    uint32_t previous;
+};
+
+// Отмечает документы, похожие на оставленный документ с меньшим индексом
+void MarkSimilarDocuments(const vector<DocumentTerms>& terms, const DuplicateSearchOptions& options, vector<char>& is_duplicate)
+{
+    const size_t band_count = options.band_count;
+    const size_t rows_per_band = options.rows_per_band;
+    if (band_count * rows_per_band == 0) {
+        throw invalid_argument("MinHash signature must not be empty");
+    }
+
+    vector<uint32_t> kept_indexes;
+    int max_term_id = -1;
+    for (size_t index = 0; index < terms.size(); ++index) {
+        if (!is_duplicate[index]) {
+            kept_indexes.push_back(static_cast<uint32_t>(index));
+            for (size_t i = 0; i < terms[index].size; ++i) {
+                max_term_id = max(max_term_id, terms[index].term_ids[i]);
+            }
+        }
+    }
+    // хеши слов не зависят от полосы, поэтому считаются один раз
+    vector<TermHashes> term_hashes(static_cast<size_t>(max_term_id + 1));
+    for (size_t term_id = 0; term_id < term_hashes.size(); ++term_id) {
+        term_hashes[term_id] = { MixHash(term_id, 3), MixHash(term_id, 4) | 1 };
+    }
+
+    // Полосы обрабатываются по одной: документы сортируются по (хеш, индекс), и для каждого
+    // документа не первой в своей корзине запоминается предыдущий. Документы в корзинах
+    // из одного документа ничего не занимают, массив полосы освобождается до следующей
+    vector<vector<BucketLink>> band_links(band_count);
+    {
+        vector<pair<uint64_t, uint32_t>> band_documents(kept_indexes.size());
+        for (size_t band = 0; band < band_count; ++band) {
+            transform(execution::par, kept_indexes.begin(), kept_indexes.end(), band_documents.begin(), [&](uint32_t index) {
+                return pair{ ComputeBandHash(terms[index], term_hashes, band, rows_per_band), index };
+            });
+            sort(execution::par, band_documents.begin(), band_documents.end());
+            vector<BucketLink>& links = band_links[band];
+            for (size_t i = 1; i < band_documents.size(); ++i) {
+                if (band_documents[i].first == band_documents[i - 1].first) {
+                    links.push_back({ band_documents[i].second, band_documents[i - 1].second });
+                }
+            }
+            sort(links.begin(), links.end(), [](const BucketLink& lhs, const BucketLink& rhs) {
+                return lhs.index < rhs.index;
+            });
+            links.shrink_to_fit();
+        }
+    }
+    // ссылка документа на предыдущий в корзине; nullptr, если документ в корзине первый
+    const auto find_link = [&band_links](size_t band, uint32_t index) -> BucketLink* {
+        vector<BucketLink>& links = band_links[band];
+        const auto it = lower_bound(links.begin(), links.end(), index, [](const BucketLink& link, uint32_t index) {
+            return link.index < index;
+        });
+        return it != links.end() && it->index == index ? &*it : nullptr;
+    };
+
+    // Документы проверяются по возрастанию индекса: кандидаты - оставленные документы
+    // перед ним в его корзинах, не больше max_candidates_per_band в каждой. Найденный
+    // в цепочке дубликат вырезается из неё, поэтому по каждому дубликату в полосе
+    // проходят один раз
+    for (const uint32_t index : kept_indexes) {
+        bool is_similar = false;
+        for (size_t band = 0; band < band_count && !is_similar; ++band) {
+            BucketLink* link = find_link(band, index);
+            for (size_t candidate_count = 0; link && link->previous != UINT32_MAX && !is_similar
+                 && candidate_count < options.max_candidates_per_band;) {
+                const uint32_t candidate = link->previous;
+                BucketLink* candidate_link = find_link(band, candidate);
+                if (is_duplicate[candidate]) {
+                    link->previous = candidate_link ? candidate_link->previous : UINT32_MAX;
+                    continue;
+                }
+                ++candidate_count;
+                is_similar = ComputeJaccardSimilarity(terms[candidate], terms[index]) >= options.min_similarity;
+                link = candidate_link;
+            }
+        }
+        if (is_similar) {
+            is_duplicate[index] = true;
+        }
+    }
+}
+
+} // namespace
+
+bool DocumentFingerprint::operator==(const DocumentFingerprint& other) const
+{
+    return high == other.high && low == other.low;
+}
+
+bool DocumentFingerprint::operator<(const DocumentFingerprint& other) const
+{
+    return tie(high, low) < tie(other.high, other.low);
+}
+
+// id слов идут по возрастанию, поэтому у одинаковых множеств отпечатки совпадают
+DocumentFingerprint ComputeDocumentFingerprint(const DocumentTerms& terms)
+{
+    DocumentFingerprint fingerprint{ terms.size, ~uint64_t{ terms.size } };
+    for (size_t i = 0; i < terms.size; ++i) {
+        fingerprint.high = MixHash(fingerprint.high ^ static_cast<uint32_t>(terms.term_ids[i]), 1);
+        fingerprint.low = MixHash(fingerprint.low ^ static_cast<uint32_t>(terms.term_ids[i]), 2);
+    }
+    return fingerprint;
+}
+
+void MarkExactDuplicates(const vector<DocumentTerms>& terms, const vector<DocumentFingerprint>& fingerprints, vector<char>& is_duplicate)
+{
+    vector<size_t> order(terms.size());
+    iota(order.begin(), order.end(), 0);
+    sort(execution::par, order.begin(), order.end(), [&fingerprints](size_t lhs, size_t rhs) {
+        return tie(fingerprints[lhs], lhs) < tie(fingerprints[rhs], rhs);
+    });
+
+    for (size_t begin = 0; begin < order.size();) {
+        size_t end = begin + 1;
+        while (end < order.size() && fingerprints[order[end]] == fingerprints[order[begin]]) {
+            ++end;
+        }
+        // совпадение отпечатков подтверждается сравнением слов
+        for (size_t i = begin + 1; i < end; ++i) {
+            for (size_t j = begin; j < i; ++j) {
+                if (!is_duplicate[order[j]] && HaveSameTerms(terms[order[j]], terms[order[i]])) {
+                    is_duplicate[order[i]] = true;
+                    break;
+                }
+            }
+        }
+        begin = end;
+    }
+}
+
+vector<int> FindDuplicates(const SearchServer& search_server, const DuplicateSearchOptions& options)
+{
+    // индексы документов идут по возрастанию id
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    vector<DocumentTerms> terms(document_ids.size());
+    transform(execution::par, document_ids.begin(), document_ids.end(), terms.begin(), [&search_server](int document_id) {
+        return search_server.GetDocumentTerms(document_id);
+    });
+
+    vector<DocumentFingerprint> fingerprints(terms.size());
+    transform(execution::par, terms.begin(), terms.end(), fingerprints.begin(), ComputeDocumentFingerprint);
+    vector<char> is_duplicate(document_ids.size(), false);
+    MarkExactDuplicates(terms, fingerprints, is_duplicate);
+    if (options.min_similarity > 0.0) {
+        MarkSimilarDocuments(terms, options, is_duplicate);
+    }
+
+    vector<int> duplicate_ids;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (is_duplicate[i]) {
+            duplicate_ids.push_back(document_ids[i]);
+        }
+    }
+    return duplicate_ids;
+}
+
+void RemoveDuplicates(SearchServer& search_server)
+{
+    RemoveDuplicates(search_server, DuplicateSearchOptions());
+}
+
+void RemoveDuplicates(SearchServer& search_server, const DuplicateSearchOptions& options)
+{
+    const vector<int> duplicate_ids = FindDuplicates(search_server, options);
+    for (const int document_id : duplicate_ids) {
+        cout << "Found duplicate document id "s << document_id << endl;
+    }
+    search_server.RemoveDocuments(execution::par, duplicate_ids);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct DuplicateSearchOptions
+{
+    // 0 - дубликаты только с тем же множеством слов. Иначе дубликатами считаются
+    // и документы, у которых коэффициент Жаккара множеств слов не меньше порога
+    double min_similarity = 0.0;
+    // Похожие документы ищутся по MinHash-подписи из band_count полос по rows_per_band
+    // значений: кандидаты - документы, у которых совпала хотя бы одна полоса
+    size_t band_count = 16;
+    size_t rows_per_band = 4;
+    // Сколько оставленных документов корзины каждой полосы сравнивается с документом.
+    // Ограничивает работу в больших корзинах; похожий документ дальше в корзине
+    // может найтись по другой полосе
+    size_t max_candidates_per_band = 32;
+};
+
+// 128-битный отпечаток множества слов документа: у одинаковых множеств отпечатки совпадают
+struct DocumentFingerprint
+{
+    uint64_t high;
+    uint64_t low;
+
+    bool operator==(const DocumentFingerprint &other) const;
+    bool operator<(const DocumentFingerprint &other) const;
+};
+
+DocumentFingerprint ComputeDocumentFingerprint(const SearchServer::DocumentTerms &terms);
+
+// Отмечает в is_duplicate документы с тем же множеством слов, что у документа с меньшим
+// индексом. Документы группируются по отпечаткам, а совпадение отпечатков проверяется
+// сравнением слов, поэтому при коллизии разные документы не становятся дубликатами
+void MarkExactDuplicates(const std::vector<SearchServer::DocumentTerms> &terms, const std::vector<DocumentFingerprint> &fingerprints,
+                         std::vector<char> &is_duplicate);
+
+// id дубликатов по возрастанию. Из группы одинаковых документов остаётся документ
+// с меньшим id; похожий документ - дубликат, если похож на оставленный документ с меньшим id.
+// Отпечатки и подписи документов считаются параллельно
+std::vector<int> FindDuplicates(const SearchServer &search_server,
+                                const DuplicateSearchOptions &options = DuplicateSearchOptions());
+
+// Удаляет найденные FindDuplicates документы и сообщает о каждом в cout.
+// Без параметров удаляет документы с тем же множеством слов, что у документа с меньшим id
+void RemoveDuplicates(SearchServer &search_server);
+void RemoveDuplicates(SearchServer &search_server, const DuplicateSearchOptions &options);
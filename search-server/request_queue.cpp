@@ -1,52 +1,208 @@
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 #include <string>
+#include <utility>
 #include "request_queue.h"
 
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
+namespace {
+
+atomic<uint64_t> next_queue_id{ 1 };
+
+
+}
+
+struct RequestQueue::ThreadShards
+{
+    ~ThreadShards()
+    {
+        for (const auto& [weak_registry, shard] : shards) {
+            if (const auto registry = weak_registry.lock()) {
+                registry->Retire(shard);
+            }
+        }
+    }
+
+    // буферы удалённых очередей освобождены вместе с ними
+    vector<pair<weak_ptr<ShardRegistry>, Shard*>> shards;
+};
+
+RequestQueue::Shard::Shard(size_t bucket_count)
+    : buckets(bucket_count)
+{
+}
+
+RequestQueue::ShardRegistry::ShardRegistry(size_t bucket_count)
+    : retired(bucket_count)
+{
+}
+
+void RequestQueue::ShardRegistry::Retire(const Shard* shard)
+{
+    lock_guard lock(mutex);
+    // поток завершился, поэтому его буфер больше не меняется
+    for (size_t i = 0; i < shard->buckets.size(); ++i) {
+        const Bucket& bucket = shard->buckets[i];
+        Bucket& retired_bucket = retired.buckets[i];
+        const uint64_t epoch = bucket.epoch.load(memory_order_relaxed);
+        const uint64_t retired_epoch = retired_bucket.epoch.load(memory_order_relaxed);
+        if (epoch == UINT64_MAX || (retired_epoch != UINT64_MAX && retired_epoch > epoch)) {
+            continue;
+        }
+        // корзина с тем же индексом и меньшим номером относится к окну, которое уже прошло
+        if (retired_epoch != epoch) {
+            retired_bucket.epoch.store(epoch, memory_order_relaxed);
+            retired_bucket.requests.store(0, memory_order_relaxed);
+            retired_bucket.no_result_requests.store(0, memory_order_relaxed);
+        }
+        retired_bucket.requests.fetch_add(bucket.requests.load(memory_order_relaxed), memory_order_relaxed);
+        retired_bucket.no_result_requests.fetch_add(bucket.no_result_requests.load(memory_order_relaxed), memory_order_relaxed);
+    }
+    retired.latency.Add(shard->latency);
+    shards.erase(find_if(shards.begin(), shards.end(), [shard](const unique_ptr<Shard>& registered_shard) {
+        return registered_shard.get() == shard;
+    }));
+}
+
+RequestQueue::RequestQueue(const SearchServer& search_server, Options options)
     : search_server_(search_server)
-    , no_results_requests_(0)
-    , current_time_(0)
+    , bucket_width_(options.bucket_width)
+    , bucket_count_(options.bucket_width.count() > 0 ? static_cast<size_t>((options.window + options.bucket_width - chrono::milliseconds(1)) / options.bucket_width) : 0)
+    , start_time_(Clock::now())
+    , id_(next_queue_id++)
+    , registry_(make_shared<ShardRegistry>(bucket_count_))
 {
+    if (options.bucket_width.count() <= 0 || options.window.count() <= 0) {
+        throw invalid_argument("Request window and bucket width must be positive");
+    }
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status)
 {
-    const auto result = search_server_.FindTopDocuments(raw_query, status);
-    AddRequest(result.size());
-    return result;
+    return RunRequest([&] {
+        return search_server_.FindTopDocuments(raw_query, status);
+    });
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
 {
-    const auto result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(result.size());
-    return result;
+    return RunRequest([&] {
+        return search_server_.FindTopDocuments(raw_query);
+    });
+}
+
+void RequestQueue::RecordRequest(size_t result_count, chrono::nanoseconds latency)
+{
+    Record(result_count, latency, Clock::now());
 }
 
 int RequestQueue::GetNoResultRequests() const
 {
-    return no_results_requests_;
+    return static_cast<int>(CountWindow().no_result_requests);
 }
 
-void RequestQueue::AddRequest(int results_num)
+int RequestQueue::GetRequestCount() const
 {
-    // новый запрос - новая секунда
-    ++current_time_;
-    // удаляем все результаты поиска, которые устарели
-    while (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp)
-    {
-        if (0 == requests_.front().results)
-        {
-            --no_results_requests_;
-        }
-        requests_.pop_front();
+    return static_cast<int>(CountWindow().requests);
+}
+
+double RequestQueue::GetNoResultRate() const
+{
+    const WindowCounts counts = CountWindow();
+    return counts.requests == 0 ? 0.0 : static_cast<double>(counts.no_result_requests) / counts.requests;
+}
+
+DurationHistogram RequestQueue::GetLatencyHistogram() const
+{
+    lock_guard lock(registry_->mutex);
+    DurationHistogram histogram(registry_->retired.latency);
+    for (const auto& shard : registry_->shards) {
+        histogram.Add(shard->latency);
     }
-    // сохраняем новый результат поиска
-    requests_.push_back({current_time_, results_num});
-    if (0 == results_num)
-    {
-        ++no_results_requests_;
+    return histogram;
+}
+
+RequestQueue::Shard& RequestQueue::GetThreadShard()
+{
+    // поток обычно пишет в одну очередь, поэтому её буфер запоминается без блокировки
+    thread_local uint64_t cached_queue_id = 0;
+    thread_local Shard* cached_shard = nullptr;
+    if (cached_queue_id == id_) {
+        return *cached_shard;
+    }
+
+    thread_local ThreadShards thread_shards;
+    auto& shards = thread_shards.shards;
+    shards.erase(remove_if(shards.begin(), shards.end(), [](const auto& registry_shard) {
+        return registry_shard.first.expired();
+    }), shards.end());
+    const auto it = find_if(shards.begin(), shards.end(), [this](const auto& registry_shard) {
+        return registry_shard.first.lock() == registry_;
+    });
+    Shard* shard = nullptr;
+    if (it != shards.end()) {
+        shard = it->second;
+    }
+    else {
+        lock_guard lock(registry_->mutex);
+        shard = registry_->shards.emplace_back(make_unique<Shard>(bucket_count_)).get();
+        shards.emplace_back(registry_, shard);
+    }
+    cached_queue_id = id_;
+    cached_shard = shard;
+    return *shard;
+}
+
+void RequestQueue::Record(size_t result_count, chrono::nanoseconds latency, Clock::time_point now)
+{
+    Shard& shard = GetThreadShard();
+    const uint64_t epoch = static_cast<uint64_t>((now - start_time_) / bucket_width_);
+    Bucket& bucket = shard.buckets[epoch % bucket_count_];
+    // у буфера один писатель, поэтому достаточно загрузки и записи без блокировки шины
+    if (bucket.epoch.load(memory_order_relaxed) != epoch) {
+        // как в seqlock: читатель, заставший обнуление, увидит смену номера и перечитает корзину
+        bucket.epoch.store(UINT64_MAX, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        bucket.requests.store(0, memory_order_relaxed);
+        bucket.no_result_requests.store(0, memory_order_relaxed);
+        bucket.epoch.store(epoch, memory_order_release);
+    }
+    bucket.requests.store(bucket.requests.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    if (result_count == 0) {
+        bucket.no_result_requests.store(bucket.no_result_requests.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+    shard.latency.Record(static_cast<uint64_t>(max<int64_t>(latency.count(), 0)));
+}
+
+RequestQueue::WindowCounts RequestQueue::CountWindow() const
+{
+    const uint64_t current_epoch = static_cast<uint64_t>((Clock::now() - start_time_) / bucket_width_);
+    WindowCounts counts;
+    lock_guard lock(registry_->mutex);
+    const auto count_shard = [&](const Shard& shard) {
+        for (const Bucket& bucket : shard.buckets) {
+            uint64_t epoch = 0;
+            uint64_t requests = 0;
+            uint64_t no_result_requests = 0;
+            // счётчики относятся к epoch, только если номер не изменился за время чтения
+            do {
+                epoch = bucket.epoch.load(memory_order_acquire);
+                requests = bucket.requests.load(memory_order_relaxed);
+                no_result_requests = bucket.no_result_requests.load(memory_order_relaxed);
+                atomic_thread_fence(memory_order_acquire);
+            } while (bucket.epoch.load(memory_order_relaxed) != epoch);
+            if (epoch <= current_epoch && current_epoch - epoch < bucket_count_) {
+                counts.requests += requests;
+                counts.no_result_requests += no_result_requests;
+            }
+        }
+    };
+    count_shard(registry_->retired);
+    for (const auto& shard : registry_->shards) {
+        count_shard(*shard);
     }
+    return counts;
 }
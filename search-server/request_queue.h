@@ -1,14 +1,40 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
-#include <deque>
 #include <iostream>
+#include "query_metrics.h"
 #include "search_server.h"
 
+struct RequestQueueOptions
+{
+    // за какой период считается статистика запросов
+    std::chrono::milliseconds window = std::chrono::hours(24);
+    // ширина корзины скользящего окна; окно сдвигается на целые корзины
+    std::chrono::milliseconds bucket_width = std::chrono::minutes(1);
+};
+
+// Статистика запросов за последнее окно по часам steady_clock. Методы можно
+// вызывать из разных потоков. Каждый пишущий поток получает свой кольцевой
+// буфер корзин и гистограмму задержек и пишет в них без блокировок; чтение
+// складывает буферы всех потоков. Когда поток завершается, его счётчики
+// добавляются к общему буферу завершившихся потоков, а его буфер освобождается,
+// так что память не растёт с числом когда-либо писавших потоков. Пока идут записи,
+// чтение видит каждую корзину либо до, либо после записи и никогда не
+// смешивает счётчики старой корзины времени с номером новой
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    using Options = RequestQueueOptions;
+
+    explicit RequestQueue(const SearchServer& search_server, Options options = Options());
+
+    RequestQueue(const RequestQueue&) = delete;
+    RequestQueue& operator=(const RequestQueue&) = delete;
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
@@ -17,26 +43,93 @@ public:
 
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
+    // Учитывает запрос, выполненный в обход очереди, например в пакете ProcessQueries
+    void RecordRequest(size_t result_count, std::chrono::nanoseconds latency);
+
+    // Запросы без результатов за окно
     int GetNoResultRequests() const;
+    // Все запросы за окно
+    int GetRequestCount() const;
+    // Доля запросов без результатов за окно; 0, если запросов не было
+    double GetNoResultRate() const;
+    // Задержки всех учтённых запросов с создания очереди в наносекундах
+    DurationHistogram GetLatencyHistogram() const;
 
 private:
-    struct QueryResult {
-        uint64_t timestamp;
-        int results;
+    using Clock = std::chrono::steady_clock;
+
+    struct Bucket
+    {
+        // номер корзины времени, к которой относятся счётчики;
+        // UINT64_MAX, пока корзина пуста или обнуляется
+        std::atomic<uint64_t> epoch{ UINT64_MAX };
+        std::atomic<uint32_t> requests{ 0 };
+        std::atomic<uint32_t> no_result_requests{ 0 };
+    };
+
+    // Пишет в буфер только его поток
+    struct Shard
+    {
+        explicit Shard(size_t bucket_count);
+
+        std::vector<Bucket> buckets;
+        DurationHistogram latency;
     };
-    std::deque<QueryResult> requests_;
+
+    // Буферы потоков очереди. Живёт, пока жива очередь или поток, который её не отпустил
+    struct ShardRegistry
+    {
+        explicit ShardRegistry(size_t bucket_count);
+
+        // Добавляет счётчики буфера завершившегося потока к retired и освобождает буфер
+        void Retire(const Shard* shard);
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> shards;
+        // счётчики завершившихся потоков; меняются только под mutex
+        Shard retired;
+    };
+
+    // Буферы потока во всех очередях, в которые он писал; отдаёт их очередям при завершении потока
+    struct ThreadShards;
+
+    struct WindowCounts
+    {
+        uint64_t requests = 0;
+        uint64_t no_result_requests = 0;
+    };
+
     const SearchServer& search_server_;
-    int no_results_requests_;
-    uint64_t current_time_;
-    static constexpr int min_in_day_ = 1440;
+    const Clock::duration bucket_width_;
+    const size_t bucket_count_;
+    const Clock::time_point start_time_;
+    // отличает очередь от удалённой ранее по тому же адресу в кэше потока
+    const uint64_t id_;
 
-    void AddRequest(int results_num);
+    const std::shared_ptr<ShardRegistry> registry_;
+
+    Shard& GetThreadShard();
+    void Record(size_t result_count, std::chrono::nanoseconds latency, Clock::time_point now);
+    WindowCounts CountWindow() const;
+
+    template <typename Search>
+    std::vector<Document> RunRequest(Search search);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate)
 {
-    const auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
-    AddRequest(result.size());
+    return RunRequest([&] {
+        return search_server_.FindTopDocuments(raw_query, document_predicate);
+    });
+}
+
+template <typename Search>
+std::vector<Document> RequestQueue::RunRequest(Search search)
+{
+    const Clock::time_point start = Clock::now();
+    auto result = search();
+    const Clock::time_point finish = Clock::now();
+    Record(result.size(), std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start), finish);
     return result;
 }
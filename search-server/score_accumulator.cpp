@@ -0,0 +1,77 @@
+#include "score_accumulator.h"
+
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Свободные аккумуляторы потока. Их может быть несколько, если поток
+// берёт задачу другого запроса, пока ждёт завершения своей
+vector<unique_ptr<ScoreAccumulator>>& GetThreadPool()
+{
+    thread_local vector<unique_ptr<ScoreAccumulator>> pool;
+    return pool;
+}
+
+}
+
+ScoreAccumulator::Lease::Lease(unique_ptr<ScoreAccumulator> accumulator)
+    : accumulator_(move(accumulator))
+{
+}
+
+ScoreAccumulator::Lease::~Lease()
+{
+    if (accumulator_) {
+        accumulator_->Clear();
+        GetThreadPool().push_back(move(accumulator_));
+    }
+}
+
+ScoreAccumulator::Lease ScoreAccumulator::Acquire(int first_ordinal, size_t ordinal_count)
+{
+    auto& pool = GetThreadPool();
+    unique_ptr<ScoreAccumulator> accumulator;
+    if (pool.empty()) {
+        accumulator = make_unique<ScoreAccumulator>();
+    }
+    else {
+        accumulator = move(pool.back());
+        pool.pop_back();
+    }
+    accumulator->Reserve(first_ordinal, ordinal_count);
+    return Lease(move(accumulator));
+}
+
+void ScoreAccumulator::Reserve(int first_ordinal, size_t ordinal_count)
+{
+    first_ordinal_ = first_ordinal;
+    // аккумулятор потока не держит память под самый большой диапазон из всех запросов:
+    // массивы заново выделяются по размеру, если диапазон намного меньше их
+    if (scores_.size() > min_shrink_size_ && ordinal_count < scores_.size() / shrink_factor_) {
+        scores_ = vector<double>(ordinal_count, 0.0);
+        touched_bits_ = vector<uint64_t>((ordinal_count + 63) / 64, 0);
+        excluded_bits_ = vector<uint64_t>((ordinal_count + 63) / 64, 0);
+        touched_.shrink_to_fit();
+        excluded_.shrink_to_fit();
+    }
+    else if (scores_.size() < ordinal_count) {
+        scores_.resize(ordinal_count, 0.0);
+        touched_bits_.resize((ordinal_count + 63) / 64, 0);
+        excluded_bits_.resize((ordinal_count + 63) / 64, 0);
+    }
+}
+
+void ScoreAccumulator::Clear()
+{
+    for (const int index : touched_) {
+        scores_[index] = 0.0;
+        ResetBit(touched_bits_, index);
+    }
+    for (const int index : excluded_) {
+        ResetBit(excluded_bits_, index);
+    }
+    touched_.clear();
+    excluded_.clear();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Плотный массив релевантностей для диапазона порядковых номеров документов
+// [first_ordinal, first_ordinal + ordinal_count).
+// Сброс между запросами стоит O(затронутых документов), а не O(всех).
+class ScoreAccumulator {
+public:
+    // Аккумулятор, взятый из пула текущего потока; возвращается в пул очищенным
+    class Lease {
+    public:
+        explicit Lease(std::unique_ptr<ScoreAccumulator> accumulator);
+        Lease(Lease&& other) = default;
+        Lease& operator=(Lease&& other) = default;
+        ~Lease();
+
+        ScoreAccumulator& operator*() const
+        {
+            return *accumulator_;
+        }
+
+        ScoreAccumulator* operator->() const
+        {
+            return accumulator_.get();
+        }
+
+    private:
+        std::unique_ptr<ScoreAccumulator> accumulator_;
+    };
+
+    static Lease Acquire(int first_ordinal, size_t ordinal_count);
+
+    void Reserve(int first_ordinal, size_t ordinal_count);
+    void Clear();
+
+    bool IsTouched(int ordinal) const
+    {
+        return TestBit(touched_bits_, ordinal - first_ordinal_);
+    }
+
+    bool IsExcluded(int ordinal) const
+    {
+        return TestBit(excluded_bits_, ordinal - first_ordinal_);
+    }
+
+    void Exclude(int ordinal)
+    {
+        const int index = ordinal - first_ordinal_;
+        if (!TestBit(excluded_bits_, index)) {
+            SetBit(excluded_bits_, index);
+            excluded_.push_back(index);
+        }
+    }
+
+    void Add(int ordinal, double value)
+    {
+        const int index = ordinal - first_ordinal_;
+        if (!TestBit(touched_bits_, index)) {
+            SetBit(touched_bits_, index);
+            touched_.push_back(index);
+        }
+        scores_[index] += value;
+    }
+
+    double GetScore(int ordinal) const
+    {
+        return scores_[ordinal - first_ordinal_];
+    }
+
+    // Затронутые и не исключённые документы в порядке первого касания
+    template <typename Function>
+    void ForEachScored(Function function) const;
+
+private:
+    static constexpr size_t min_shrink_size_ = size_t{ 1 } << 16;
+    static constexpr size_t shrink_factor_ = 4;
+
+    int first_ordinal_ = 0;
+    std::vector<double> scores_;
+    std::vector<uint64_t> touched_bits_;
+    std::vector<uint64_t> excluded_bits_;
+    // индексы относительно first_ordinal_
+    std::vector<int> touched_;
+    std::vector<int> excluded_;
+
+    static bool TestBit(const std::vector<uint64_t>& bits, int index)
+    {
+        return (bits[index >> 6] >> (index & 63)) & 1;
+    }
+
+    static void SetBit(std::vector<uint64_t>& bits, int index)
+    {
+        bits[index >> 6] |= uint64_t{ 1 } << (index & 63);
+    }
+
+    static void ResetBit(std::vector<uint64_t>& bits, int index)
+    {
+        bits[index >> 6] &= ~(uint64_t{ 1 } << (index & 63));
+    }
+};
+
+template <typename Function>
+void ScoreAccumulator::ForEachScored(Function function) const
+{
+    for (const int index : touched_) {
+        if (!TestBit(excluded_bits_, index)) {
+            function(first_ordinal_ + index, scores_[index]);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#include "search_cursor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+SearchCursor::SearchCursor(const Document& last_document)
+    : is_start_(false)
+    , last_document_(last_document)
+{
+}
+
+bool SearchCursor::IsStart() const
+{
+    return is_start_;
+}
+
+bool SearchCursor::operator==(const SearchCursor& other) const
+{
+    if (is_start_ || other.is_start_) {
+        return is_start_ == other.is_start_;
+    }
+    return memcmp(&last_document_.relevance, &other.last_document_.relevance, sizeof(last_document_.relevance)) == 0
+        && last_document_.rating == other.last_document_.rating && last_document_.id == other.last_document_.id;
+}
+
+bool SearchCursor::operator!=(const SearchCursor& other) const
+{
+    return !(*this == other);
+}
+
+// Формат: биты релевантности, рейтинг и id в шестнадцатеричном виде через ':'
+string SearchCursor::ToString() const
+{
+    if (is_start_) {
+        return {};
+    }
+    uint64_t relevance_bits;
+    memcpy(&relevance_bits, &last_document_.relevance, sizeof(relevance_bits));
+    const auto to_hex = [](uint64_t value) {
+        string hex;
+        do {
+            hex.insert(hex.begin(), "0123456789abcdef"[value % 16]);
+            value /= 16;
+        } while (value > 0);
+        return hex;
+    };
+    return to_hex(relevance_bits) + ':' + to_hex(static_cast<uint32_t>(last_document_.rating)) + ':'
+        + to_hex(static_cast<uint32_t>(last_document_.id));
+}
+
+SearchCursor SearchCursor::Parse(string_view text)
+{
+    if (text.empty()) {
+        return SearchCursor();
+    }
+    uint64_t fields[3];
+    const uint64_t max_fields[3] = { UINT64_MAX, UINT32_MAX, UINT32_MAX };
+    for (size_t field = 0; field < 3; ++field) {
+        const size_t separator = field < 2 ? text.find(':') : text.size();
+        if (separator == 0 || separator == text.npos || separator > 16) {
+            throw invalid_argument("Invalid search cursor");
+        }
+        fields[field] = 0;
+        for (const char c : text.substr(0, separator)) {
+            const char* digit = c == '\0' ? nullptr : strchr("0123456789abcdef", c);
+            if (!digit) {
+                throw invalid_argument("Invalid search cursor");
+            }
+            fields[field] = fields[field] * 16 + (digit - "0123456789abcdef");
+        }
+        if (fields[field] > max_fields[field]) {
+            throw invalid_argument("Invalid search cursor");
+        }
+        text.remove_prefix(min(text.size(), separator + 1));
+    }
+
+    Document last_document;
+    memcpy(&last_document.relevance, &fields[0], sizeof(last_document.relevance));
+    last_document.rating = static_cast<int32_t>(static_cast<uint32_t>(fields[1]));
+    last_document.id = static_cast<int32_t>(static_cast<uint32_t>(fields[2]));
+    if (last_document.id < 0) {
+        throw invalid_argument("Invalid search cursor");
+    }
+    return SearchCursor(last_document);
+}
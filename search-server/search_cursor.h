@@ -0,0 +1,41 @@
+#pragma once
+
+#include "document.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Позиция в выдаче: последний документ предыдущей страницы в порядке
+// IsMoreRelevant. Курсор по умолчанию указывает на начало выдачи.
+// Страницы согласованы, пока индекс не меняется
+class SearchCursor {
+public:
+    SearchCursor() = default;
+
+    bool IsStart() const;
+
+    // Курсоры равны, если указывают на одну позицию; релевантность сравнивается побитово
+    bool operator==(const SearchCursor& other) const;
+    bool operator!=(const SearchCursor& other) const;
+
+    // Непрозрачная строка для передачи клиенту; релевантность сохраняется точно
+    std::string ToString() const;
+    // Бросает invalid_argument, если строка получена не из ToString
+    static SearchCursor Parse(std::string_view text);
+
+private:
+    friend class SearchServer;
+
+    explicit SearchCursor(const Document& last_document);
+
+    bool is_start_ = true;
+    Document last_document_;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // курсор для следующей страницы
+    SearchCursor next_cursor;
+    bool has_next_page = false;
+};
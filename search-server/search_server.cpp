@@ -1,6 +1,7 @@
 #include "search_server.h"
 #include "document.h"
 #include "string_processing.h"
+#include "term_intersection.h"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
@@ -15,6 +16,8 @@
 #include <string_view>
 #include <deque>
 #include <execution>
+#include <thread>
+#include <exception>
 
 using namespace std;
 
@@ -28,25 +31,315 @@ SearchServer::SearchServer(string_view stop_words_text)
 {
 }
 
+SearchServer::SearchServer(StopWordSet stop_words)
+    : stop_words_(move(stop_words))
+{
+    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+        throw invalid_argument("Some of stop words are invalid"s);
+    }
+}
+
+SearchServer::SearchServer(shared_ptr<const IndexSnapshot> snapshot)
+    : snapshot_(move(snapshot))
+    , stop_words_(MakeUniqueNonEmptyStrings(snapshot_->GetStopWords()))
+    , terms_(snapshot_->GetTermTable())
+{
+    // списки ссылаются на файл, а логарифмы числа документов записаны в снимке
+    const size_t term_count = snapshot_->GetTermCount();
+    word_to_document_freqs_.reserve(term_count);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        word_to_document_freqs_.emplace_back(CompressedPostings(snapshot_->GetPostings(static_cast<int>(term_id))));
+    }
+    const double* log_document_freqs = snapshot_->GetTermLogDocumentFreqs();
+    log_document_freqs_.assign(log_document_freqs, log_document_freqs + term_count);
+
+    // номера в снимке идут по возрастанию id, поэтому вставка всегда в конец
+    snapshot_document_count_ = static_cast<int>(snapshot_->GetDocumentCount());
+    ordinal_to_id_.reserve(snapshot_document_count_);
+    attributes_.Reserve(snapshot_document_count_);
+    for (int ordinal = 0; ordinal < snapshot_document_count_; ++ordinal) {
+        const IndexSnapshotDocument& document = snapshot_->GetDocument(ordinal);
+        documents_.emplace_hint(documents_.end(), document.id,
+                                DocumentData{ document.rating, static_cast<DocumentStatus>(document.status), ordinal, {}, {} });
+        document_ids_.emplace_hint(document_ids_.end(), document.id);
+        ordinal_to_id_.push_back(document.id);
+        attributes_.Add(static_cast<DocumentStatus>(document.status), document.rating);
+    }
+    UpdateLogDocumentCount();
+}
+
+SearchServer SearchServer::Open(const string& path, bool verify_checksum)
+{
+    return SearchServer(make_shared<const IndexSnapshot>(path, verify_checksum));
+}
+
+void SearchServer::Save(const string& path) const
+{
+    IndexSnapshotWriter writer(path);
+    writer.WriteStopWords(stop_words_);
+    writer.WriteTerms(terms_);
+
+    // в снимке документы нумеруются заново по возрастанию id, удалённые пропадают
+    vector<int> snapshot_ordinals(ordinal_to_id_.size(), -1);
+    int snapshot_ordinal = 0;
+    for (const auto& [document_id, document_data] : documents_) {
+        snapshot_ordinals[document_data.ordinal] = snapshot_ordinal++;
+    }
+    vector<Posting> postings;
+    for (const PostingList& term_postings : word_to_document_freqs_) {
+        postings.clear();
+        term_postings.ForEach([&](const Posting& posting) {
+            postings.push_back({ snapshot_ordinals[posting.ordinal], posting.term_freq });
+        });
+        sort(postings.begin(), postings.end(), [](const Posting& lhs, const Posting& rhs) {
+            return lhs.ordinal < rhs.ordinal;
+        });
+        writer.WritePostings(CompressedPostings(postings));
+    }
+
+    for (const auto& [document_id, document_data] : documents_) {
+        const DocumentTerms terms = GetDocumentTerms(document_data);
+        writer.WriteDocument(document_id, document_data.rating, document_data.status, terms.term_ids, terms.term_freqs, terms.size);
+    }
+    writer.Finish();
+}
+
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings)
 {
     if ((document_id < 0) || (documents_.count(document_id) > 0)) {
         throw invalid_argument("Invalid document_id");
     }
-    const auto words = SplitIntoWordsNoStop(document);
+    vector<string_view> words;
+    SplitIntoWordsNoStop(document, words);
     const double inv_word_count = 1.0 / words.size();
-    set<string, less<>> document_words;
-
+    map<int, double> term_freqs;
     for (const auto& word : words) {
-        string word_str(word);
-        document_words.insert(word_str);
+        term_freqs[terms_.Intern(word)] += inv_word_count;
+    }
+    IndexDocument(document_id, ComputeAverageRating(ratings), status, term_freqs);
+}
+
+void SearchServer::AddDocumentTerms(int document_id, int rating, DocumentStatus status, const map<string_view, double>& word_freqs)
+{
+    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+        throw invalid_argument("Invalid document_id");
+    }
+    map<int, double> term_freqs;
+    for (const auto& [word, term_freq] : word_freqs) {
+        term_freqs.emplace(terms_.Intern(word), term_freq);
+    }
+    IndexDocument(document_id, rating, status, term_freqs);
+}
 
-        word_to_document_freqs_[static_cast<string_view>(*document_words.find(word_str))][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][static_cast<string_view>(*document_words.find(word_str))] += inv_word_count;
+void SearchServer::IndexDocument(int document_id, int rating, DocumentStatus status, const map<int, double>& term_freqs)
+{
+    if (word_to_document_freqs_.size() < terms_.size()) {
+        word_to_document_freqs_.resize(terms_.size());
+        log_document_freqs_.resize(terms_.size());
     }
 
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, move(document_words) });
+    const int ordinal = static_cast<int>(ordinal_to_id_.size());
+    DocumentData document_data{ rating, status, ordinal, {}, {} };
+    document_data.term_ids.reserve(term_freqs.size());
+    document_data.term_freqs.reserve(term_freqs.size());
+    for (const auto& [term_id, term_freq] : term_freqs) {
+        document_data.term_ids.push_back(term_id);
+        document_data.term_freqs.push_back(term_freq);
+        word_to_document_freqs_[term_id].Add(ordinal, term_freq);
+        UpdateLogDocumentFreq(term_id);
+    }
+
+    documents_.emplace(document_id, move(document_data));
+    ordinal_to_id_.push_back(document_id);
+    attributes_.Add(status, rating);
     document_ids_.emplace(document_id);
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+template <class ExecutionPolicy>
+void SearchServer::AddDocumentBatch(ExecutionPolicy policy, const vector<NewDocument>& documents)
+{
+    vector<int> document_ids;
+    document_ids.reserve(documents.size());
+    for (const NewDocument& document : documents) {
+        if (document.id < 0 || documents_.count(document.id) > 0) {
+            throw invalid_argument("Invalid document_id");
+        }
+        document_ids.push_back(document.id);
+    }
+    sort(document_ids.begin(), document_ids.end());
+    if (adjacent_find(document_ids.begin(), document_ids.end()) != document_ids.end()) {
+        throw invalid_argument("Invalid document_id");
+    }
+
+    struct BatchPosting
+    {
+        int term_id;
+        int ordinal;
+        double term_freq;
+
+        bool operator<(const BatchPosting& other) const
+        {
+            return term_id < other.term_id || (term_id == other.term_id && ordinal < other.ordinal);
+        }
+    };
+    // кусок документов пакета с подряд идущими номерами
+    struct Chunk
+    {
+        size_t first_document;
+        size_t last_document;
+        // слова документов куска подряд; id -1 у слов, которых ещё нет в словаре
+        vector<string_view> words;
+        vector<int> term_ids;
+        vector<size_t> word_ends;
+        vector<string_view> new_words;
+        exception_ptr error;
+        // частичный индекс куска по возрастанию id слова, затем номера
+        vector<BatchPosting> postings;
+        vector<DocumentData> documents;
+    };
+
+    const size_t max_chunk_count = max(1u, thread::hardware_concurrency()) * 4;
+    const size_t chunk_count = max<size_t>(1, min(max_chunk_count, documents.size() / min_documents_per_chunk_));
+    const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+    vector<Chunk> chunks(chunk_count);
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        chunks[chunk].first_document = min(documents.size(), chunk * chunk_size);
+        chunks[chunk].last_document = min(documents.size(), (chunk + 1) * chunk_size);
+    }
+
+    // словарь до вставки новых слов только читается
+    for_each(policy, chunks.begin(), chunks.end(), [&](Chunk& chunk) {
+        try {
+            for (size_t i = chunk.first_document; i < chunk.last_document; ++i) {
+                const size_t first_word = chunk.words.size();
+                SplitIntoWordsNoStop(documents[i].text, chunk.words);
+                for (size_t j = first_word; j < chunk.words.size(); ++j) {
+                    const int term_id = terms_.Find(chunk.words[j]);
+                    if (term_id < 0) {
+                        chunk.new_words.push_back(chunk.words[j]);
+                    }
+                    chunk.term_ids.push_back(term_id);
+                }
+                chunk.word_ends.push_back(chunk.words.size());
+            }
+        }
+        catch (...) {
+            chunk.error = current_exception();
+        }
+    });
+    for (const Chunk& chunk : chunks) {
+        if (chunk.error) {
+            rethrow_exception(chunk.error);
+        }
+    }
+
+    for (const Chunk& chunk : chunks) {
+        for (const string_view word : chunk.new_words) {
+            terms_.Intern(word);
+        }
+    }
+    word_to_document_freqs_.resize(terms_.size());
+    log_document_freqs_.resize(terms_.size());
+
+    const int first_ordinal = static_cast<int>(ordinal_to_id_.size());
+    for_each(policy, chunks.begin(), chunks.end(), [&](Chunk& chunk) {
+        chunk.documents.reserve(chunk.last_document - chunk.first_document);
+        vector<int> term_ids;
+        size_t word_begin = 0;
+        for (size_t i = chunk.first_document; i < chunk.last_document; ++i) {
+            const size_t word_end = chunk.word_ends[i - chunk.first_document];
+            term_ids.clear();
+            for (size_t word = word_begin; word < word_end; ++word) {
+                const int term_id = chunk.term_ids[word];
+                term_ids.push_back(term_id < 0 ? terms_.Find(chunk.words[word]) : term_id);
+            }
+            sort(term_ids.begin(), term_ids.end());
+
+            // частоты складываются так же, как в AddDocument, и совпадают побитово
+            const double inv_word_count = 1.0 / (word_end - word_begin);
+            const int ordinal = first_ordinal + static_cast<int>(i);
+            DocumentData document_data{ ComputeAverageRating(documents[i].ratings), documents[i].status, ordinal, {}, {} };
+            for (const int term_id : term_ids) {
+                if (document_data.term_ids.empty() || document_data.term_ids.back() != term_id) {
+                    document_data.term_ids.push_back(term_id);
+                    document_data.term_freqs.push_back(0.0);
+                }
+                document_data.term_freqs.back() += inv_word_count;
+            }
+            for (size_t term = 0; term < document_data.term_ids.size(); ++term) {
+                chunk.postings.push_back({ document_data.term_ids[term], ordinal, document_data.term_freqs[term] });
+            }
+            chunk.documents.push_back(move(document_data));
+            word_begin = word_end;
+        }
+        chunk.words = {};
+        chunk.term_ids = {};
+        sort(chunk.postings.begin(), chunk.postings.end());
+    });
+
+    // границы диапазонов слов по выборке из частичных индексов, чтобы
+    // потокам досталось примерно поровну документов
+    vector<int> sampled_term_ids;
+    for (const Chunk& chunk : chunks) {
+        const size_t step = max<size_t>(1, chunk.postings.size() / (chunk_count * 8));
+        for (size_t i = 0; i < chunk.postings.size(); i += step) {
+            sampled_term_ids.push_back(chunk.postings[i].term_id);
+        }
+    }
+    sort(sampled_term_ids.begin(), sampled_term_ids.end());
+    vector<int> range_bounds = { 0 };
+    for (size_t range = 1; range < chunk_count && !sampled_term_ids.empty(); ++range) {
+        const int bound = sampled_term_ids[range * sampled_term_ids.size() / chunk_count];
+        if (bound > range_bounds.back()) {
+            range_bounds.push_back(bound);
+        }
+    }
+    range_bounds.push_back(static_cast<int>(terms_.size()));
+
+    // каждый поток дописывает свои списки слов, куски идут по возрастанию номеров.
+    // Логарифм частоты слова пересчитывается один раз на кусок, в котором оно есть
+    vector<size_t> ranges(range_bounds.size() - 1);
+    iota(ranges.begin(), ranges.end(), 0);
+    for_each(policy, ranges.begin(), ranges.end(), [&](size_t range) {
+        for (const Chunk& chunk : chunks) {
+            auto it = lower_bound(chunk.postings.begin(), chunk.postings.end(), BatchPosting{ range_bounds[range], 0, 0.0 });
+            for (; it != chunk.postings.end() && it->term_id < range_bounds[range + 1]; ++it) {
+                word_to_document_freqs_[it->term_id].Add(it->ordinal, it->term_freq);
+                if (next(it) == chunk.postings.end() || next(it)->term_id != it->term_id) {
+                    UpdateLogDocumentFreq(it->term_id);
+                }
+            }
+        }
+    });
+
+    for (Chunk& chunk : chunks) {
+        for (size_t i = chunk.first_document; i < chunk.last_document; ++i) {
+            const DocumentData& document_data = chunk.documents[i - chunk.first_document];
+            attributes_.Add(document_data.status, document_data.rating);
+            documents_.emplace(documents[i].id, move(chunk.documents[i - chunk.first_document]));
+            ordinal_to_id_.push_back(documents[i].id);
+            document_ids_.emplace(documents[i].id);
+        }
+    }
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+void SearchServer::AddDocuments(const vector<NewDocument>& documents)
+{
+    AddDocumentBatch(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(execution::sequenced_policy seq_police, const vector<NewDocument>& documents)
+{
+    AddDocumentBatch(seq_police, documents);
+}
+
+void SearchServer::AddDocuments(execution::parallel_policy par_police, const vector<NewDocument>& documents)
+{
+    AddDocumentBatch(par_police, documents);
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const
@@ -54,9 +347,140 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const
     return FindTopDocuments(execution::seq, raw_query);
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t max_document_count) const
+{
+    return FindTopDocuments(execution::seq, raw_query, status, max_document_count);
+}
+
+SearchPage SearchServer::FindNextPage(string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentStatus status) const
+{
+    return FindNextPage(execution::seq, raw_query, cursor, page_size, status);
+}
+
+vector<Document> SearchServer::FindTopDocuments(RetrievalMode mode, string_view raw_query, DocumentStatus status, size_t max_document_count) const
+{
+    return FindTopDocuments(mode, raw_query, DocumentStatusPredicate{ status }, max_document_count);
+}
+
+QueryBatchResults SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries, DocumentStatus status, size_t max_document_count) const
+{
+    const size_t query_count = raw_queries.size();
+    vector<size_t> query_indexes(query_count);
+    iota(query_indexes.begin(), query_indexes.end(), 0);
+
+    vector<Query> queries(query_count);
+    vector<exception_ptr> errors(query_count);
+    for_each(execution::par, query_indexes.begin(), query_indexes.end(), [&](size_t query_index) {
+        try {
+            queries[query_index] = ParseQuery(raw_queries[query_index], true);
+        }
+        catch (...) {
+            errors[query_index] = current_exception();
+        }
+    });
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+    // различные слова пакета; у запроса - индексы его плюс- и минус-слов среди них
+    unordered_map<string_view, size_t> word_indexes;
+    vector<string_view> words;
+    vector<vector<size_t>> plus_word_indexes(query_count);
+    vector<vector<size_t>> minus_word_indexes(query_count);
+    const auto index_words = [&](const vector<string_view>& query_words, vector<size_t>& indexes) {
+        indexes.reserve(query_words.size());
+        for (const string_view word : query_words) {
+            const auto [it, inserted] = word_indexes.emplace(word, words.size());
+            if (inserted) {
+                words.push_back(word);
+            }
+            indexes.push_back(it->second);
+        }
+    };
+    for (size_t query_index = 0; query_index < query_count; ++query_index) {
+        index_words(queries[query_index].plus_words, plus_word_indexes[query_index]);
+        index_words(queries[query_index].minus_words, minus_word_indexes[query_index]);
+    }
+
+    struct WordTerm
+    {
+        const PostingList* postings;
+        double inverse_document_freq;
+    };
+    vector<WordTerm> word_terms(words.size());
+    transform(execution::par, words.begin(), words.end(), word_terms.begin(), [this](string_view word) {
+        const int term_id = terms_.Find(word);
+        if (term_id < 0) {
+            return WordTerm{ nullptr, 0.0 };
+        }
+        const PostingList& postings = word_to_document_freqs_[term_id];
+        return WordTerm{ &postings, postings.empty() ? 0.0 : ComputeWordInverseDocumentFreq(term_id) };
+    });
+
+    // слова запроса идут в том же порядке, что в LookupQueryTerms, поэтому релевантность совпадает побитово
+    vector<QueryTerms> query_terms(query_count);
+    vector<size_t> query_costs(query_count, 0);
+    for (size_t query_index = 0; query_index < query_count; ++query_index) {
+        QueryTerms& terms = query_terms[query_index];
+        for (const size_t word_index : plus_word_indexes[query_index]) {
+            const WordTerm& word_term = word_terms[word_index];
+            if (word_term.postings && !word_term.postings->empty()) {
+                terms.plus_postings.emplace_back(word_term.postings, word_term.inverse_document_freq);
+                query_costs[query_index] += word_term.postings->size();
+            }
+        }
+        for (const size_t word_index : minus_word_indexes[query_index]) {
+            if (const PostingList* postings = word_terms[word_index].postings) {
+                terms.minus_postings.push_back(postings);
+                query_costs[query_index] += postings->size();
+            }
+        }
+    }
+
+    // дорогие запросы начинаются первыми, чтобы в конце пакета потоки не ждали одного из них.
+    // Запрос дороже доли одного потока во всём пакете делится по диапазонам номеров
+    vector<size_t> query_order = query_indexes;
+    sort(query_order.begin(), query_order.end(), [&query_costs](size_t lhs, size_t rhs) {
+        return query_costs[lhs] > query_costs[rhs];
+    });
+    const size_t split_cost = accumulate(query_costs.begin(), query_costs.end(), size_t{ 0 }) / max(1u, thread::hardware_concurrency());
+
+    const int ordinal_count = static_cast<int>(ordinal_to_id_.size());
+    const DocumentStatusPredicate document_predicate{ status };
+    vector<vector<Document>> query_documents(query_count);
+    for_each(execution::par, query_order.begin(), query_order.end(), [&](size_t query_index) {
+        const QueryTerms& terms = query_terms[query_index];
+        query_documents[query_index] = FindCachedTopDocuments(queries[query_index], GetPredicateId(document_predicate), max_document_count, [&] {
+            auto matched_documents = query_costs[query_index] > split_cost && ComputeOrdinalRangeCount(terms, ordinal_count) > 1
+                ? FindAllDocuments(execution::par, terms, document_predicate)
+                : FindAllDocuments(execution::seq, terms, document_predicate);
+            QUERY_STAGE(QueryStage::TOP_K);
+            SelectTopDocuments(execution::seq, matched_documents, max_document_count);
+            return matched_documents;
+        });
+    });
+
+    vector<size_t> offsets(query_count + 1, 0);
+    for (size_t query_index = 0; query_index < query_count; ++query_index) {
+        offsets[query_index + 1] = offsets[query_index] + query_documents[query_index].size();
+    }
+    vector<Document> documents(offsets.back());
+    for_each(execution::par, query_indexes.begin(), query_indexes.end(), [&](size_t query_index) {
+        copy(query_documents[query_index].begin(), query_documents[query_index].end(), documents.begin() + offsets[query_index]);
+    });
+    return QueryBatchResults(move(documents), move(offsets));
+}
+
+void SearchServer::EnableQueryCache(size_t capacity, size_t shard_count)
 {
-    return FindTopDocuments(execution::seq, raw_query, status);
+    query_cache_ = make_unique<QueryResultCache>(capacity, shard_count);
+}
+
+QueryCacheStats SearchServer::GetQueryCacheStats() const
+{
+    return query_cache_ ? query_cache_->GetStats() : QueryCacheStats{};
 }
 
 int SearchServer::GetDocumentCount() const
@@ -66,12 +490,23 @@ int SearchServer::GetDocumentCount() const
 
 const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
 {
+    lock_guard lock(word_frequencies_mutex_);
     auto it = document_to_word_freqs_.find(document_id);
     if (it != document_to_word_freqs_.end()) {
         return it->second;
     }
-    static map<string_view, double> empty;
-    return empty;
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end()) {
+        static map<string_view, double> empty;
+        return empty;
+    }
+
+    const DocumentTerms terms = GetDocumentTerms(document_it->second);
+    auto& word_freqs = document_to_word_freqs_[document_id];
+    for (size_t i = 0; i < terms.size; ++i) {
+        word_freqs.emplace(terms_.GetTerm(terms.term_ids[i]), terms.term_freqs[i]);
+    }
+    return word_freqs;
 }
 
 set<int>::const_iterator SearchServer::begin() const
@@ -84,20 +519,54 @@ set<int>::const_iterator SearchServer::end() const
     return document_ids_.end();
 }
 
+void SearchServer::CompressIndex()
+{
+    for (auto& postings : word_to_document_freqs_) {
+        postings.Freeze();
+    }
+    // сжатие меняет индекс, поэтому, как и любое изменение, сбрасывает кэш
+    ++index_version_;
+}
+
+size_t SearchServer::GetIndexMemoryUsage() const
+{
+    // узел std::map и std::set: три указателя и цвет
+    constexpr size_t tree_node_size = 4 * sizeof(void*);
+    size_t memory_usage = terms_.GetMemoryUsage() + attributes_.GetMemoryUsage()
+        + (word_to_document_freqs_.capacity() - word_to_document_freqs_.size()) * sizeof(PostingList)
+        + log_document_freqs_.capacity() * sizeof(double)
+        + ordinal_to_id_.capacity() * sizeof(int)
+        + document_ids_.size() * (tree_node_size + sizeof(int));
+    for (const auto& postings : word_to_document_freqs_) {
+        memory_usage += postings.GetMemoryUsage();
+    }
+    for (const auto& [document_id, document_data] : documents_) {
+        memory_usage += tree_node_size + sizeof(documents_.begin()->first) + sizeof(DocumentData)
+            + document_data.term_ids.capacity() * sizeof(int)
+            + document_data.term_freqs.capacity() * sizeof(double);
+    }
+    return memory_usage;
+}
+
 void SearchServer::RemoveDocument(int document_id)
 {
     if (!document_ids_.count(document_id)) {
         return;
     }
 
-    auto& words_for_erase = document_to_word_freqs_.at(document_id);
-    for (auto& [word, freq] : words_for_erase) {
-        word_to_document_freqs_.at(word).erase(document_id);
+    const auto& document_data = documents_.at(document_id);
+    const DocumentTerms terms = GetDocumentTerms(document_data);
+    for (size_t i = 0; i < terms.size; ++i) {
+        word_to_document_freqs_[terms.term_ids[i]].Remove(document_data.ordinal);
+        UpdateLogDocumentFreq(terms.term_ids[i]);
     }
 
+    attributes_.Remove(document_data.ordinal);
     document_ids_.erase(document_id);
     documents_.erase(document_id);
     document_to_word_freqs_.erase(document_id);
+    UpdateLogDocumentCount();
+    ++index_version_;
 }
 
 void SearchServer::RemoveDocument(execution::sequenced_policy seq_police, int document_id)
@@ -110,21 +579,102 @@ void SearchServer::RemoveDocument(execution::parallel_policy par_police, int doc
     if (!document_ids_.count(document_id)) {
         return;
     }
-    auto& words_for_erase = document_to_word_freqs_.at(document_id);
-
-    vector<string_view> words;
-    words.reserve(words_for_erase.size());
-    transform(par_police, words_for_erase.begin(), words_for_erase.end(), words.begin(), [](const auto& word) {
-        return word.first;
-    });
 
-    for_each(par_police, words.begin(), words.end(), [&](const auto& word) {
-        word_to_document_freqs_.at(word).erase(document_id);
+    // слова документа различны, поэтому потоки меняют разные списки
+    const auto& document_data = documents_.at(document_id);
+    const DocumentTerms terms = GetDocumentTerms(document_data);
+    for_each(par_police, terms.term_ids, terms.term_ids + terms.size, [&](int term_id) {
+        word_to_document_freqs_[term_id].Remove(document_data.ordinal);
+        UpdateLogDocumentFreq(term_id);
     });
 
+    attributes_.Remove(document_data.ordinal);
     document_ids_.erase(document_id);
     documents_.erase(document_id);
     document_to_word_freqs_.erase(document_id);
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+template <class ExecutionPolicy>
+void SearchServer::RemoveDocumentBatch(ExecutionPolicy policy, const vector<int>& document_ids)
+{
+    vector<pair<int, DocumentTerms>> removed_documents;
+    removed_documents.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        const auto it = documents_.find(document_id);
+        if (it != documents_.end()) {
+            removed_documents.emplace_back(it->second.ordinal, GetDocumentTerms(it->second));
+        }
+    }
+    if (removed_documents.empty()) {
+        return;
+    }
+    sort(policy, removed_documents.begin(), removed_documents.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+    removed_documents.erase(unique(removed_documents.begin(), removed_documents.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+    }), removed_documents.end());
+
+    // номера удаляемых документов раскладываются по словам подсчётом:
+    // у каждого слова получается отрезок номеров по возрастанию
+    vector<size_t> term_offsets(word_to_document_freqs_.size() + 1, 0);
+    for (const auto& [ordinal, terms] : removed_documents) {
+        for (size_t i = 0; i < terms.size; ++i) {
+            ++term_offsets[terms.term_ids[i] + 1];
+        }
+    }
+    vector<int> affected_term_ids;
+    for (size_t term_id = 0; term_id + 1 < term_offsets.size(); ++term_id) {
+        if (term_offsets[term_id + 1] > 0) {
+            affected_term_ids.push_back(static_cast<int>(term_id));
+        }
+        term_offsets[term_id + 1] += term_offsets[term_id];
+    }
+    vector<int> term_ordinals(term_offsets.back());
+    vector<size_t> term_positions(term_offsets.begin(), term_offsets.end() - 1);
+    for (const auto& [ordinal, terms] : removed_documents) {
+        for (size_t i = 0; i < terms.size; ++i) {
+            term_ordinals[term_positions[terms.term_ids[i]]++] = ordinal;
+        }
+    }
+
+    // каждое слово меняет только свой список и свой логарифм частоты
+    for_each(policy, affected_term_ids.begin(), affected_term_ids.end(), [&](int term_id) {
+        PostingList& postings = word_to_document_freqs_[term_id];
+        postings.Remove(term_ordinals.data() + term_offsets[term_id], term_ordinals.data() + term_offsets[term_id + 1]);
+        if (postings.empty()) {
+            postings = PostingList();
+        }
+        UpdateLogDocumentFreq(term_id);
+    });
+
+    // документы удаляются после списков: их слова могли лежать в DocumentData
+    for (const auto& [ordinal, terms] : removed_documents) {
+        const int document_id = ordinal_to_id_[ordinal];
+        attributes_.Remove(ordinal);
+        document_ids_.erase(document_id);
+        documents_.erase(document_id);
+        document_to_word_freqs_.erase(document_id);
+    }
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids)
+{
+    RemoveDocumentBatch(execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(execution::sequenced_policy seq_police, const vector<int>& document_ids)
+{
+    RemoveDocumentBatch(seq_police, document_ids);
+}
+
+void SearchServer::RemoveDocuments(execution::parallel_policy par_police, const vector<int>& document_ids)
+{
+    RemoveDocumentBatch(par_police, document_ids);
 }
 
 SearchServer::MatchResult SearchServer::MatchDocument(string_view raw_query, int document_id) const
@@ -134,65 +684,120 @@ SearchServer::MatchResult SearchServer::MatchDocument(string_view raw_query, int
 
 SearchServer::MatchResult SearchServer::MatchDocument(execution::sequenced_policy police, string_view raw_query, int document_id) const
 {
-    const auto query = ParseQuery(raw_query, true);
+    const MatchTerms terms = LookupMatchTerms(ParseQuery(raw_query, true));
+    return MatchDocument(terms, documents_.at(document_id));
+}
 
-    const auto status_doc = documents_.at(document_id).status;
+SearchServer::MatchResult SearchServer::MatchDocument(const execution::parallel_policy& police, string_view raw_query, int document_id) const
+{
+    // для одного документа сопоставление дешевле запуска потоков
+    return MatchDocument(execution::seq, raw_query, document_id);
+}
 
-    for (const string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        auto& map = word_to_document_freqs_.at(word);
-        if (map.count(document_id)) {
-            return { {}, status_doc };
-        }
-    }
-    vector<string_view> matched_words;
-    for (const string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        auto& map = word_to_document_freqs_.at(word);
-        if (map.count(document_id)) {
-            matched_words.push_back(word);
-        }
+template <class ExecutionPolicy>
+vector<SearchServer::MatchResult> SearchServer::MatchDocumentBatch(ExecutionPolicy policy, string_view raw_query, const vector<int>& document_ids) const
+{
+    const MatchTerms terms = LookupMatchTerms(ParseQuery(raw_query, true));
+    vector<const DocumentData*> documents(document_ids.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        documents[i] = &documents_.at(document_ids[i]);
     }
+    vector<MatchResult> results(document_ids.size());
+    transform(policy, documents.begin(), documents.end(), results.begin(), [&](const DocumentData* document_data) {
+        return MatchDocument(terms, *document_data);
+    });
+    return results;
+}
 
-    return { matched_words, documents_.at(document_id).status };
+vector<SearchServer::MatchResult> SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const
+{
+    return MatchDocumentBatch(execution::seq, raw_query, document_ids);
 }
 
-SearchServer::MatchResult SearchServer::MatchDocument(const execution::parallel_policy& police, string_view raw_query, int document_id) const
+vector<SearchServer::MatchResult> SearchServer::MatchDocuments(execution::sequenced_policy seq_police, string_view raw_query, const vector<int>& document_ids) const
 {
-    auto query = ParseQuery(raw_query, false);
+    return MatchDocumentBatch(seq_police, raw_query, document_ids);
+}
 
-    sort(query.minus_words.begin(), query.minus_words.end());
-    auto minus_words_end = unique(query.minus_words.begin(), query.minus_words.end());
+vector<SearchServer::MatchResult> SearchServer::MatchDocuments(execution::parallel_policy par_police, string_view raw_query, const vector<int>& document_ids) const
+{
+    return MatchDocumentBatch(par_police, raw_query, document_ids);
+}
 
-    const auto& doc_data = documents_.at(document_id);
+SearchServer::MatchTerms SearchServer::LookupMatchTerms(const Query& query) const
+{
+    vector<pair<int, string_view>> plus_terms;
+    plus_terms.reserve(query.plus_words.size());
+    for (const string_view word : query.plus_words) {
+        const int term_id = terms_.Find(word);
+        if (term_id >= 0) {
+            plus_terms.emplace_back(term_id, word);
+        }
+    }
+    sort(plus_terms.begin(), plus_terms.end());
+
+    MatchTerms terms;
+    terms.plus_term_ids.reserve(plus_terms.size());
+    terms.plus_words.reserve(plus_terms.size());
+    for (const auto& [term_id, word] : plus_terms) {
+        terms.plus_term_ids.push_back(term_id);
+        terms.plus_words.push_back(word);
+    }
+    for (const string_view word : query.minus_words) {
+        const int term_id = terms_.Find(word);
+        if (term_id >= 0) {
+            terms.minus_term_ids.push_back(term_id);
+        }
+    }
+    sort(terms.minus_term_ids.begin(), terms.minus_term_ids.end());
+    return terms;
+}
 
+SearchServer::MatchResult SearchServer::MatchDocument(const MatchTerms& terms, const DocumentData& document_data) const
+{
+    const DocumentTerms document_terms = GetDocumentTerms(document_data);
     vector<string_view> matched_words;
-    if (any_of(query.minus_words.begin(), minus_words_end, [&](const auto& word) {
-        return doc_data.words.count(word);
-    })) {
-        return { matched_words, documents_.at(document_id).status };
+    if (HaveCommonTermId(terms.minus_term_ids.data(), terms.minus_term_ids.size(), document_terms.term_ids, document_terms.size)) {
+        return { matched_words, document_data.status };
     }
 
-    sort(query.plus_words.begin(), query.plus_words.end());
-    auto plus_words_end = unique(query.plus_words.begin(), query.plus_words.end());
-
-    matched_words.reserve(distance(query.plus_words.begin(), plus_words_end));
-    for_each(query.plus_words.begin(), plus_words_end, [&](const auto& word) {
-        if (doc_data.words.count(word)) {
-            matched_words.push_back(word);
+    // запрос пересекается с документом частями, чтобы номера совпадений помещались в стек
+    constexpr size_t max_part_size = 64;
+    size_t positions[max_part_size];
+    for (size_t first = 0; first < terms.plus_term_ids.size(); first += max_part_size) {
+        const size_t part_size = min(max_part_size, terms.plus_term_ids.size() - first);
+        const size_t match_count = IntersectTermIds(terms.plus_term_ids.data() + first, part_size,
+                                                    document_terms.term_ids, document_terms.size, positions);
+        for (size_t i = 0; i < match_count; ++i) {
+            matched_words.push_back(terms.plus_words[first + positions[i]]);
         }
-    });
+    }
+    // совпавшие слова выдаются по алфавиту
+    sort(matched_words.begin(), matched_words.end());
+    return { matched_words, document_data.status };
+}
+
+SearchServer::DocumentTerms SearchServer::GetDocumentTerms(int document_id) const
+{
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return { nullptr, nullptr, 0 };
+    }
+    return GetDocumentTerms(it->second);
+}
 
-    return { matched_words, documents_.at(document_id).status };
+SearchServer::DocumentTerms SearchServer::GetDocumentTerms(const DocumentData& document_data) const
+{
+    const int ordinal = document_data.ordinal;
+    if (ordinal < snapshot_document_count_) {
+        return { snapshot_->GetDocumentTermIds(ordinal), snapshot_->GetDocumentTermFreqs(ordinal), snapshot_->GetDocument(ordinal).term_count };
+    }
+    return { document_data.term_ids.data(), document_data.term_freqs.data(), document_data.term_ids.size() };
 }
 
 bool SearchServer::IsStopWord(string_view word) const
 {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(string_view word)
@@ -202,18 +807,17 @@ bool SearchServer::IsValidWord(string_view word)
     });
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const
+void SearchServer::SplitIntoWordsNoStop(string_view text, vector<string_view>& words) const
 {
-    vector<string_view> words;
-    for (const string_view& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw invalid_argument("Word "s + string(word) + " is invalid"s);
+    WordTokenizer tokenizer(text);
+    for (Token token; tokenizer.Next(token);) {
+        if (!token.is_valid) {
+            throw invalid_argument("Word "s + string(token.word) + " is invalid"s);
         }
-        if (!IsStopWord(word)) {
-            words.push_back(move(word));
+        if (!IsStopWord(token.word)) {
+            words.push_back(token.word);
         }
     }
-    return words;
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings)
@@ -222,18 +826,15 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings)
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(string_view& word) const
+SearchServer::QueryWord SearchServer::ParseQueryWord(const Token& token) const
 {
-    if (word.empty()) {
-        throw invalid_argument("Query word is empty"s);
-    }
-
+    string_view word = token.word;
     bool is_minus = false;
     if (word[0] == '-') {
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+    if (word.empty() || word[0] == '-' || !token.is_valid) {
         throw invalid_argument("Query word "s + string(word) + " is invalid");
     }
     return { word, is_minus, IsStopWord(word) };
@@ -241,13 +842,11 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view& word) const
 
 SearchServer::Query SearchServer::ParseQuery(string_view text, bool needUnique) const
 {
-    auto words = SplitIntoWords(text);
+    QUERY_STAGE(QueryStage::PARSE_QUERY);
     Query result;
-    result.minus_words.reserve(words.size());
-    result.plus_words.reserve(words.size());
-
-    for (string_view word : words) {
-        auto query_word = ParseQueryWord(word);
+    WordTokenizer tokenizer(text);
+    for (Token token; tokenizer.Next(token);) {
+        auto query_word = ParseQueryWord(token);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 result.minus_words.push_back(move(query_word.data));
@@ -269,9 +868,106 @@ SearchServer::Query SearchServer::ParseQuery(string_view text, bool needUnique)
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const
+uint64_t SearchServer::GetPredicateId(const DocumentStatusPredicate& predicate)
+{
+    // 0 означает запрос, который не кэшируется
+    return 1 + static_cast<uint64_t>(predicate.status);
+}
+
+string SearchServer::MakeQueryCacheKey(const Query& query, uint64_t predicate_id, size_t max_document_count)
+{
+    // слова не содержат пробелов и не начинаются с '-', поэтому ключ однозначен
+    string key;
+    for (const string_view word : query.plus_words) {
+        key += word;
+        key += ' ';
+    }
+    for (const string_view word : query.minus_words) {
+        key += '-';
+        key += word;
+        key += ' ';
+    }
+    key += to_string(predicate_id);
+    key += ' ';
+    key += to_string(max_document_count);
+    return key;
+}
+
+const PostingList* SearchServer::FindPostings(string_view word) const
+{
+    const int term_id = terms_.Find(word);
+    return term_id < 0 ? nullptr : &word_to_document_freqs_[term_id];
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(int term_id) const
+{
+    return log_document_count_ - log_document_freqs_[term_id];
+}
+
+void SearchServer::UpdateLogDocumentFreq(int term_id)
+{
+    const size_t document_count = word_to_document_freqs_[term_id].size();
+    log_document_freqs_[term_id] = document_count > 0 ? log(static_cast<double>(document_count)) : 0.0;
+}
+
+void SearchServer::UpdateLogDocumentCount()
+{
+    log_document_count_ = documents_.empty() ? 0.0 : log(static_cast<double>(documents_.size()));
+}
+
+SearchServer::QueryTerms SearchServer::LookupQueryTerms(const Query& query) const
+{
+    QueryTerms terms;
+    terms.plus_postings.reserve(query.plus_words.size());
+    for (const string_view word : query.plus_words) {
+        const int term_id = terms_.Find(word);
+        if (term_id >= 0 && !word_to_document_freqs_[term_id].empty()) {
+            terms.plus_postings.emplace_back(&word_to_document_freqs_[term_id], ComputeWordInverseDocumentFreq(term_id));
+        }
+    }
+    LookupMinusPostings(query, terms);
+    return terms;
+}
+
+SearchServer::QueryTerms SearchServer::LookupQueryTerms(const Query& query, const vector<double>& inverse_document_freqs) const
 {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    QueryTerms terms;
+    terms.plus_postings.reserve(query.plus_words.size());
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const PostingList* postings = FindPostings(query.plus_words[i]);
+        if (postings && !postings->empty()) {
+            terms.plus_postings.emplace_back(postings, inverse_document_freqs[i]);
+        }
+    }
+    LookupMinusPostings(query, terms);
+    return terms;
+}
+
+void SearchServer::LookupMinusPostings(const Query& query, QueryTerms& terms) const
+{
+    terms.minus_postings.reserve(query.minus_words.size());
+    for (const string_view word : query.minus_words) {
+        if (const PostingList* postings = FindPostings(word)) {
+            terms.minus_postings.push_back(postings);
+        }
+    }
+}
+
+int SearchServer::CountDocumentsWithWord(string_view word) const
+{
+    const PostingList* postings = FindPostings(word);
+    return postings ? static_cast<int>(postings->size()) : 0;
+}
+
+int SearchServer::ComputeOrdinalRangeCount(const QueryTerms& terms, int ordinal_count)
+{
+    size_t posting_count = 0;
+    for (const auto& [postings, _] : terms.plus_postings) {
+        posting_count += postings->size();
+    }
+    const size_t max_range_count = max(1u, thread::hardware_concurrency()) * 4;
+    const size_t range_count = min(max_range_count, posting_count / min_postings_per_range_ + 1);
+    return static_cast<int>(max<size_t>(1, min<size_t>(range_count, ordinal_count)));
 }
 
 void AddDocument(SearchServer& search_server, int document_id, string_view document, DocumentStatus status, const vector<int>& ratings)
@@ -301,9 +997,11 @@ void MatchDocuments(const SearchServer& search_server, string_view query)
 {
     try {
         cout << "Matching for request: "s << query << endl;
-        for (auto document_id : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        const auto results = search_server.MatchDocuments(query, document_ids);
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const auto& [words, status] = results[i];
+            PrintMatchDocumentResult(document_ids[i], words, status);
         }
     }
     catch (const exception& e) {
@@ -1,6 +1,17 @@
 #pragma once
 #include "document.h"
+#include "document_attributes.h"
+#include "index_snapshot.h"
 #include "log_duration.h"
+#include "posting_list.h"
+#include "query_batch_results.h"
+#include "query_cache.h"
+#include "query_metrics.h"
+#include "score_accumulator.h"
+#include "search_cursor.h"
+#include "stop_word_set.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
 #include "string_processing.h"
 #include "read_input_functions.h"
 #include <algorithm>
@@ -18,14 +29,32 @@
 #include <deque>
 #include <future>
 
-#include "concurrent_map.h" 
 #include <mutex>
 #include <atomic>
 #include <thread>
 #include <type_traits>
+#include <limits>
+#include <memory>
+#include <unordered_map>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double EPSILON = 1e-6;
+
+// Способ отбора документов в FindTopDocuments
+enum class RetrievalMode {
+    // оцениваются все документы, содержащие плюс-слова
+    EXHAUSTIVE,
+    // MaxScore с оценками по блокам: пропускает документы, которые не могут попасть в выдачу
+    MAX_SCORE,
+};
+
+// Документ для пакетного добавления; text должен жить до конца AddDocuments
+struct NewDocument
+{
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
 
 class SearchServer
 {
@@ -34,58 +63,206 @@ public:
     explicit SearchServer(const StringContainer &stop_words);
     explicit SearchServer(const std::string &stop_words_text);
     explicit SearchServer(std::string_view stop_words_text);
+    // Например, StaticStopWords<List>::GetSet() для списка, известного при компиляции
+    explicit SearchServer(StopWordSet stop_words);
+
+    // Открывает снимок, сохранённый Save. Файл отображается в память без разбора
+    // списков документов, поэтому поиск доступен сразу. Сервер можно изменять,
+    // файл при этом остаётся открытым и не меняется. verify_checksum проверяет
+    // сумму всего файла: без неё повреждение внутри списков не обнаруживается
+    static SearchServer Open(const std::string &path, bool verify_checksum = false);
+    // Сохраняет стоп-слова, словарь, списки документов слов и документы в файл
+    void Save(const std::string &path) const;
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const std::vector<int> &ratings);
 
+    // Добавляет пакет документов. Пакет проверяется целиком до изменения индекса:
+    // при недопустимом id или слове бросается invalid_argument и не добавляется ничего.
+    // Параллельная версия разбирает документы и строит частичные индексы по кускам,
+    // затем сливает их в списки слов, разделив слова между потоками
+    void AddDocuments(const std::vector<NewDocument> &documents);
+    void AddDocuments(std::execution::sequenced_policy seq_police, const std::vector<NewDocument> &documents);
+    void AddDocuments(std::execution::parallel_policy par_police, const std::vector<NewDocument> &documents);
+
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
     template <class ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query) const;
 
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    // max_document_count задаёт глубину выдачи, например для постраничного вывода
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <class ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <class ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Результат совпадает с полным перебором, но работает только последовательно
+    std::vector<Document> FindTopDocuments(RetrievalMode mode, std::string_view raw_query,
+                                           DocumentStatus status = DocumentStatus::ACTUAL,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(RetrievalMode mode, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Страница выдачи из page_size документов, следующих за cursor, в том же порядке, что у
+    // FindTopDocuments. Найденные документы не сортируются целиком: отбираются page_size лучших
+    // из идущих после курсора. Каждая страница заново оценивает все подходящие документы,
+    // как полный перебор, и не использует кэш запросов, поэтому глубокое листание стоит
+    // столько же, сколько первая страница. Бросает invalid_argument, если page_size равен нулю
+    SearchPage FindNextPage(std::string_view raw_query, const SearchCursor &cursor, size_t page_size,
+                            DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <class ExecutionPolicy>
+    SearchPage FindNextPage(ExecutionPolicy policy, std::string_view raw_query, const SearchCursor &cursor, size_t page_size,
+                            DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <typename DocumentPredicate>
+    SearchPage FindNextPage(std::string_view raw_query, const SearchCursor &cursor, size_t page_size,
+                            DocumentPredicate document_predicate) const;
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    SearchPage FindNextPage(ExecutionPolicy policy, std::string_view raw_query, const SearchCursor &cursor, size_t page_size,
+                            DocumentPredicate document_predicate) const;
+
+    // Пакет запросов с теми же результатами, что FindTopDocuments для каждого из них.
+    // Запросы разбираются параллельно, каждое различное слово пакета ищется в словаре
+    // один раз. Запросы выполняются параллельно от самых дорогих по числу документов
+    // в списках слов; запрос с длинными списками сам делится по диапазонам номеров.
+    // Бросает invalid_argument первого по порядку недопустимого запроса до начала поиска
+    QueryBatchResults FindTopDocumentsBatch(const std::vector<std::string> &raw_queries,
+                                            DocumentStatus status = DocumentStatus::ACTUAL,
+                                            size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Включает кэш результатов FindTopDocuments на capacity запросов. Кэшируются
+    // только запросы со статусом; ключ - слова запроса после разбора, статус
+    // и глубина выдачи. Любое изменение документов и CompressIndex
+    // делают сохранённые результаты устаревшими. Включается до начала поиска
+    void EnableQueryCache(size_t capacity, size_t shard_count = 16);
+    // Нули, если кэш не включён
+    QueryCacheStats GetQueryCacheStats() const;
 
     int GetDocumentCount() const;
 
     std::set<int>::iterator begin() const;
     std::set<int>::iterator end() const;
 
+    // Сжимает списки документов всех слов. Поиск работает со сжатыми списками
+    // без распаковки целиком, новые документы дописываются несжатыми
+    void CompressIndex();
+    // Память индекса в байтах: списки документов слов, словарь и данные документов.
+    // Кэши запросов и частот слов документов и файл снимка не учитываются
+    size_t GetIndexMemoryUsage() const;
+
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy seq_police, int document_id);
     void RemoveDocument(std::execution::parallel_policy par_police, int document_id);
 
+    // Удаляет пакет документов, отсутствующие id пропускаются. Список каждого
+    // затронутого слова сжимается один раз за один проход; списки, оставшиеся
+    // пустыми, освобождаются. Параллельная версия делит между потоками слова
+    void RemoveDocuments(const std::vector<int> &document_ids);
+    void RemoveDocuments(std::execution::sequenced_policy seq_police, const std::vector<int> &document_ids);
+    void RemoveDocuments(std::execution::parallel_policy par_police, const std::vector<int> &document_ids);
+
     const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
 
+    // Слова документа без стоп-слов как id словаря по возрастанию и их частоты
+    struct DocumentTerms
+    {
+        const int *term_ids;
+        const double *term_freqs;
+        size_t size;
+    };
+
+    // Не строит словарь частот, в отличие от GetWordFrequencies. Пусто, если документа нет;
+    // указатели действительны, пока документ не удалён. Одинаковые слова имеют одинаковые id
+    DocumentTerms GetDocumentTerms(int document_id) const;
+
     using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
     MatchResult MatchDocument(std::string_view raw_query, int document_id) const;
     MatchResult MatchDocument(std::execution::sequenced_policy seq_police, std::string_view raw_query, int document_id) const;
     MatchResult MatchDocument(const std::execution::parallel_policy &par_police, std::string_view raw_query, int document_id) const;
 
+    // Сопоставляет запрос с каждым из документов; запрос разбирается один раз.
+    // Бросает out_of_range, если какого-то документа нет
+    std::vector<MatchResult> MatchDocuments(std::string_view raw_query, const std::vector<int> &document_ids) const;
+    std::vector<MatchResult> MatchDocuments(std::execution::sequenced_policy seq_police, std::string_view raw_query,
+                                            const std::vector<int> &document_ids) const;
+    std::vector<MatchResult> MatchDocuments(std::execution::parallel_policy par_police, std::string_view raw_query,
+                                            const std::vector<int> &document_ids) const;
+
 private:
+    friend class SegmentedSearchServer;
+
     struct DocumentData
     {
         int rating;
         DocumentStatus status;
-        std::set<std::string, std::less<>> words;
+        int ordinal;
+        // слова документа по возрастанию id; у документов из снимка лежат в нём
+        std::vector<int> term_ids;
+        std::vector<double> term_freqs;
     };
 
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    struct DocumentStatusPredicate
+    {
+        DocumentStatus status;
+
+        bool operator()(int /*document_id*/, DocumentStatus document_status, int /*rating*/) const
+        {
+            return document_status == status;
+        }
+    };
+
+    // снимок, из которого открыт сервер; его документы имеют номера [0, snapshot_document_count_)
+    std::shared_ptr<const IndexSnapshot> snapshot_;
+    int snapshot_document_count_ = 0;
+
+    const StopWordSet stop_words_;
+    // слова документов хранятся один раз в словаре, индексы ссылаются на них по id
+    TermDictionary terms_;
+    // по id слова
+    std::vector<PostingList> word_to_document_freqs_;
+    // IDF слова - log_document_count_ - log_document_freqs_[id]. Логарифмы пересчитываются
+    // при изменении индекса только для затронутых слов, поэтому запрос их не вычисляет
+    std::vector<double> log_document_freqs_;
+    double log_document_count_ = 0.0;
     std::map<int, DocumentData> documents_;
     std::set<int> document_ids_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
+    // заполняется лениво в GetWordFrequencies; ключи указывают в словарь
+    mutable std::mutex word_frequencies_mutex_;
+    mutable std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
+    // порядковые номера выдаются по мере добавления и не переиспользуются
+    std::vector<int> ordinal_to_id_;
+    // статусы и рейтинги по порядковому номеру, чтобы фильтровать документы без поиска в documents_
+    DocumentAttributes attributes_;
+
+    // nullptr, если кэш не включён
+    std::unique_ptr<QueryResultCache> query_cache_;
+    // увеличивается при каждом добавлении и удалении документов
+    uint64_t index_version_ = 0;
+
+    explicit SearchServer(std::shared_ptr<const IndexSnapshot> snapshot);
+
+    DocumentTerms GetDocumentTerms(const DocumentData &document_data) const;
+
+    // term_freqs - частоты слов документа по id слова в словаре сервера
+    void IndexDocument(int document_id, int rating, DocumentStatus status, const std::map<int, double> &term_freqs);
+    // Добавляет документ с уже посчитанными рейтингом и частотами слов
+    void AddDocumentTerms(int document_id, int rating, DocumentStatus status, const std::map<std::string_view, double> &word_freqs);
+    // Число документов со словом
+    int CountDocumentsWithWord(std::string_view word) const;
 
     bool IsStopWord(std::string_view word) const;
 
     static bool IsValidWord(std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    // Дописывает в words слова text без стоп-слов
+    void SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view> &words) const;
 
     static int ComputeAverageRating(const std::vector<int> &ratings);
 
@@ -96,7 +273,7 @@ private:
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(std::string_view &text) const;
+    QueryWord ParseQueryWord(const Token &token) const;
 
     struct Query
     {
@@ -106,16 +283,86 @@ private:
 
     Query ParseQuery(std::string_view text, bool needUnique = true) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Идентификатор предиката в ключе кэша; 0, если результаты с ним не кэшируются
+    static uint64_t GetPredicateId(const DocumentStatusPredicate &predicate);
+    template <typename DocumentPredicate>
+    static uint64_t GetPredicateId(const DocumentPredicate &predicate);
+    // query должен быть разобран с удалением повторов
+    static std::string MakeQueryCacheKey(const Query &query, uint64_t predicate_id, size_t max_document_count);
+    // Результат из кэша или search()
+    template <typename Search>
+    std::vector<Document> FindCachedTopDocuments(const Query &query, uint64_t predicate_id, size_t max_document_count,
+                                                 Search search) const;
+
+    // nullptr, если слово не встречалось в документах
+    const PostingList *FindPostings(std::string_view word) const;
+
+    // Для слова с непустым списком документов
+    double ComputeWordInverseDocumentFreq(int term_id) const;
+    // Вызывается после изменения списка документов слова
+    void UpdateLogDocumentFreq(int term_id);
+    // Вызывается после изменения числа документов
+    void UpdateLogDocumentCount();
+
+    struct QueryTerms
+    {
+        std::vector<std::pair<const PostingList *, double>> plus_postings;
+        std::vector<const PostingList *> minus_postings;
+    };
+
+    QueryTerms LookupQueryTerms(const Query &query) const;
+    // inverse_document_freqs задаёт IDF для каждого из query.plus_words
+    QueryTerms LookupQueryTerms(const Query &query, const std::vector<double> &inverse_document_freqs) const;
+    void LookupMinusPostings(const Query &query, QueryTerms &terms) const;
+
+    // Слова запроса для MatchDocument: слова, которых нет в словаре, ни с чем не совпадают
+    struct MatchTerms
+    {
+        // id плюс-слов по возрастанию и сами слова в том же порядке
+        std::vector<int> plus_term_ids;
+        std::vector<std::string_view> plus_words;
+        std::vector<int> minus_term_ids;
+    };
+
+    // query должен быть разобран с удалением повторов
+    MatchTerms LookupMatchTerms(const Query &query) const;
+    MatchResult MatchDocument(const MatchTerms &terms, const DocumentData &document_data) const;
+    template <class ExecutionPolicy>
+    std::vector<MatchResult> MatchDocumentBatch(ExecutionPolicy policy, std::string_view raw_query,
+                                                const std::vector<int> &document_ids) const;
+
+    static constexpr size_t min_postings_per_range_ = 16384;
+
+    static int ComputeOrdinalRangeCount(const QueryTerms &terms, int ordinal_count);
+
+    static constexpr size_t min_documents_per_chunk_ = 1024;
+
+    template <class ExecutionPolicy>
+    void AddDocumentBatch(ExecutionPolicy policy, const std::vector<NewDocument> &documents);
+    template <class ExecutionPolicy>
+    void RemoveDocumentBatch(ExecutionPolicy policy, const std::vector<int> &document_ids);
 
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const Query &query, DocumentPredicate document_predicate) const;
 
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(ExecutionPolicy policy, const Query &query, DocumentPredicate document_predicate) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy seq_police, const QueryTerms &terms, DocumentPredicate document_predicate) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(std::execution::parallel_policy par_police, const QueryTerms &terms, DocumentPredicate document_predicate) const;
+
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy seq_police, const Query &query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocumentsMaxScore(const Query &query, DocumentPredicate &document_predicate, size_t max_document_count) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy par_police, const Query &query, DocumentPredicate document_predicate) const;
+    void ScoreDocuments(const QueryTerms &terms, int first_ordinal, int last_ordinal, DocumentPredicate &document_predicate, std::vector<Document> &matched_documents) const;
+
+    // Статус проверяется по битовому множеству, остальные предикаты получают значения из столбцов
+    template <typename DocumentPredicate>
+    bool MatchesPredicate(int ordinal, DocumentPredicate &document_predicate) const;
 };
 
 void AddDocument(SearchServer &search_server, int document_id, std::string_view document,
@@ -125,17 +372,10 @@ void FindTopDocuments(const SearchServer &search_server, std::string_view raw_qu
 
 void MatchDocuments(const SearchServer &search_server, std::string_view query);
 
-void RemoveDuplicates(SearchServer &search_server);
-
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer &stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    : SearchServer(StopWordSet(MakeUniqueNonEmptyStrings(stop_words)))
 {
-    using namespace std::string_literals;
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord))
-    {
-        throw std::invalid_argument("Some of stop words are invalid"s);
-    }
 }
 
 template <class ExecutionPolicy>
@@ -145,126 +385,406 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std
 }
 
 template <class ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status) const
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+                                                     size_t max_document_count) const
 {
-    return FindTopDocuments(policy, raw_query,
-                            [status](int document_id, DocumentStatus document_status, int rating)
-                            {
-                                return document_status == status;
-                            });
+    return FindTopDocuments(policy, raw_query, DocumentStatusPredicate{status}, max_document_count);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_document_count) const
 {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_document_count);
 }
 
 template <class ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate) const
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_document_count) const
+{
+    const auto query = ParseQuery(raw_query, true);
+    return FindCachedTopDocuments(query, GetPredicateId(document_predicate), max_document_count, [&]
+                                  {
+        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+        QUERY_STAGE(QueryStage::TOP_K);
+        SelectTopDocuments(policy, matched_documents, max_document_count);
+        return matched_documents; });
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(RetrievalMode mode, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_document_count) const
 {
+    if (mode == RetrievalMode::EXHAUSTIVE)
+    {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_document_count);
+    }
     const auto query = ParseQuery(raw_query, true);
+    return FindCachedTopDocuments(query, GetPredicateId(document_predicate), max_document_count, [&]
+                                  { return FindTopDocumentsMaxScore(query, document_predicate, max_document_count); });
+}
+
+template <class ExecutionPolicy>
+SearchPage SearchServer::FindNextPage(ExecutionPolicy policy, std::string_view raw_query, const SearchCursor &cursor, size_t page_size,
+                                      DocumentStatus status) const
+{
+    return FindNextPage(policy, raw_query, cursor, page_size, DocumentStatusPredicate{status});
+}
+
+template <typename DocumentPredicate>
+SearchPage SearchServer::FindNextPage(std::string_view raw_query, const SearchCursor &cursor, size_t page_size,
+                                      DocumentPredicate document_predicate) const
+{
+    return FindNextPage(std::execution::seq, raw_query, cursor, page_size, document_predicate);
+}
 
+template <class ExecutionPolicy, typename DocumentPredicate>
+SearchPage SearchServer::FindNextPage(ExecutionPolicy policy, std::string_view raw_query, const SearchCursor &cursor, size_t page_size,
+                                      DocumentPredicate document_predicate) const
+{
+    if (page_size == 0)
+    {
+        throw std::invalid_argument("Page size must be positive");
+    }
+    const auto query = ParseQuery(raw_query, true);
     auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    if (!cursor.IsStart())
+    {
+        const Document &last_document = cursor.last_document_;
+        matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(), [&last_document](const Document &document)
+                                               { return !IsMoreRelevant(last_document, document); }),
+                                matched_documents.end());
+    }
 
-    sort(matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs)
-         {
-             return lhs.relevance > rhs.relevance || (std::abs(lhs.relevance - rhs.relevance) < EPSILON && lhs.rating > rhs.rating);
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+    SearchPage page;
     {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        QUERY_STAGE(QueryStage::TOP_K);
+        // лишний документ показывает, есть ли следующая страница
+        SelectTopDocuments(policy, matched_documents, page_size + 1);
     }
-    return matched_documents;
+    page.has_next_page = matched_documents.size() > page_size;
+    if (page.has_next_page)
+    {
+        matched_documents.pop_back();
+    }
+    page.next_cursor = matched_documents.empty() ? cursor : SearchCursor(matched_documents.back());
+    page.documents = std::move(matched_documents);
+    return page;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query &query, DocumentPredicate document_predicate) const
+uint64_t SearchServer::GetPredicateId(const DocumentPredicate &)
 {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+    // даже предикат без состояния может читать глобальные данные, поэтому его результаты не кэшируются
+    return 0;
+}
+
+template <typename Search>
+std::vector<Document> SearchServer::FindCachedTopDocuments(const Query &query, uint64_t predicate_id, size_t max_document_count,
+                                                           Search search) const
+{
+    if (!query_cache_ || predicate_id == 0)
+    {
+        return search();
+    }
+    std::string key = MakeQueryCacheKey(query, predicate_id, max_document_count);
+    if (auto documents = query_cache_->Find(key, index_version_))
+    {
+        return std::move(*documents);
+    }
+    auto documents = search();
+    query_cache_->Insert(std::move(key), index_version_, documents);
+    return documents;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy seq_police, const Query &query, DocumentPredicate document_predicate) const
+std::vector<Document> SearchServer::FindTopDocumentsMaxScore(const Query &query, DocumentPredicate &document_predicate, size_t max_document_count) const
 {
-    std::map<int, double> document_to_relevance;
-    for (std::string_view word : query.plus_words)
+    const auto terms = LookupQueryTerms(query);
+    const bool all_merged = std::all_of(terms.plus_postings.begin(), terms.plus_postings.end(), [](const auto &term)
+                                        { return term.first->IsMerged(); });
+    if (!all_merged || max_document_count == 0)
+    {
+        auto matched_documents = FindAllDocuments(std::execution::seq, query, document_predicate);
+        QUERY_STAGE(QueryStage::TOP_K);
+        SelectTopDocuments(std::execution::seq, matched_documents, max_document_count);
+        return matched_documents;
+    }
+
+    struct TermCursor
+    {
+        PostingList::Cursor cursor;
+        double inverse_document_freq;
+        double max_score;
+    };
+    std::vector<TermCursor> cursors;
+    cursors.reserve(terms.plus_postings.size());
+    for (const auto &[postings, inverse_document_freq] : terms.plus_postings)
+    {
+        cursors.push_back({PostingList::Cursor(*postings), inverse_document_freq, postings->GetMaxTermFreq() * inverse_document_freq});
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const TermCursor &lhs, const TermCursor &rhs)
+              { return lhs.max_score < rhs.max_score; });
+    // max_score_prefix[i] - оценка сверху суммарного вклада слов 0..i
+    std::vector<double> max_score_prefix(cursors.size());
+    double max_score_sum = 0.0;
+    for (size_t i = 0; i < cursors.size(); ++i)
+    {
+        max_score_sum += cursors[i].max_score;
+        max_score_prefix[i] = max_score_sum;
+    }
+
+    const auto excluded = ScoreAccumulator::Acquire(0, ordinal_to_id_.size());
+    {
+        QUERY_STAGE(QueryStage::MINUS_FILTERING);
+        for (const PostingList *postings : terms.minus_postings)
+        {
+            postings->ForEach([&excluded](const Posting &posting)
+                              { excluded->Exclude(posting.ordinal); });
+        }
+    }
+
+    // куча с худшим из отобранных документов на вершине
+    std::vector<Document> top_documents;
+    top_documents.reserve(max_document_count + 1);
+    double threshold = -std::numeric_limits<double>::infinity();
+    // слова [0, first_essential) сами по себе не могут поднять документ выше порога
+    size_t first_essential = 0;
+    [[maybe_unused]] uint64_t visited_postings = 0;
+    [[maybe_unused]] uint64_t predicate_rejections = 0;
+    [[maybe_unused]] uint64_t scored_candidates = 0;
+
+    // куча лучших документов ведётся во время обхода, поэтому TOP_K здесь не выделяется
+    QUERY_STAGE(QueryStage::POSTING_TRAVERSAL);
+    while (first_essential < cursors.size())
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        int candidate = std::numeric_limits<int>::max();
+        for (size_t i = first_essential; i < cursors.size(); ++i)
+        {
+            if (!cursors[i].cursor.IsEnd())
+            {
+                candidate = std::min(candidate, cursors[i].cursor->ordinal);
+            }
+        }
+        if (candidate == std::numeric_limits<int>::max())
+        {
+            break;
+        }
+
+        double score = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i)
+        {
+            auto &cursor = cursors[i].cursor;
+            if (!cursor.IsEnd() && cursor->ordinal == candidate)
+            {
+                score += cursor->term_freq * cursors[i].inverse_document_freq;
+                cursor.Next();
+                ++visited_postings;
+            }
+        }
+        if (excluded->IsExcluded(candidate))
         {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
+
+        if (first_essential > 0)
         {
-            const auto &document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating))
+            if (score + max_score_prefix[first_essential - 1] < threshold - EPSILON)
             {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                continue;
+            }
+            double block_max_score = 0.0;
+            for (size_t i = 0; i < first_essential; ++i)
+            {
+                block_max_score += cursors[i].cursor.GetBlockMaxTermFreq(candidate) * cursors[i].inverse_document_freq;
+            }
+            if (score + block_max_score < threshold - EPSILON)
+            {
+                continue;
             }
         }
-    }
-    for (std::string_view word : query.minus_words)
-    {
-        if (word_to_document_freqs_.count(word) == 0)
+
+        if (!MatchesPredicate(candidate, document_predicate))
+        {
+            ++predicate_rejections;
+            continue;
+        }
+
+        bool is_pruned = false;
+        for (size_t i = first_essential; i-- > 0;)
+        {
+            if (score + max_score_prefix[i] < threshold - EPSILON)
+            {
+                is_pruned = true;
+                break;
+            }
+            auto &cursor = cursors[i].cursor;
+            cursor.Seek(candidate);
+            if (!cursor.IsEnd() && cursor->ordinal == candidate)
+            {
+                score += cursor->term_freq * cursors[i].inverse_document_freq;
+                ++visited_postings;
+            }
+        }
+        if (is_pruned)
         {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+
+        ++scored_candidates;
+        const Document document(ordinal_to_id_[candidate], score, attributes_.GetRating(candidate));
+        if (top_documents.size() == max_document_count)
+        {
+            if (!IsMoreRelevant(document, top_documents.front()))
+            {
+                continue;
+            }
+            std::pop_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+            top_documents.pop_back();
+        }
+        top_documents.push_back(document);
+        std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+
+        if (top_documents.size() == max_document_count)
         {
-            document_to_relevance.erase(document_id);
+            threshold = top_documents.front().relevance;
+            while (first_essential < cursors.size() && max_score_prefix[first_essential] < threshold - EPSILON)
+            {
+                ++first_essential;
+            }
         }
     }
 
+    QUERY_COUNT(QueryCounter::POSTINGS_VISITED, visited_postings);
+    QUERY_COUNT(QueryCounter::PREDICATE_REJECTIONS, predicate_rejections);
+    QUERY_COUNT(QueryCounter::CANDIDATES_SCORED, scored_candidates);
+
+    std::sort(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    return top_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const Query &query, DocumentPredicate document_predicate) const
+{
+    return FindAllDocuments(std::execution::seq, query, document_predicate);
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, const Query &query, DocumentPredicate document_predicate) const
+{
+    return FindAllDocuments(policy, LookupQueryTerms(query), document_predicate);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy seq_police, const QueryTerms &terms, DocumentPredicate document_predicate) const
+{
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance)
+    ScoreDocuments(terms, 0, static_cast<int>(ordinal_to_id_.size()), document_predicate, matched_documents);
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy par_police, const QueryTerms &terms, DocumentPredicate document_predicate) const
+{
+    const int ordinal_count = static_cast<int>(ordinal_to_id_.size());
+
+    // диапазоны номеров документов не пересекаются, поэтому каждый поток
+    // считает свой кусок всех списков без блокировок, в том числе длинных
+    const int range_count = ComputeOrdinalRangeCount(terms, ordinal_count);
+    const int range_size = (ordinal_count + range_count - 1) / range_count;
+    std::vector<std::vector<Document>> range_documents(range_count);
+
+    std::for_each(par_police, range_documents.begin(), range_documents.end(), [&](std::vector<Document> &documents)
+                  {
+        const int first_ordinal = static_cast<int>(&documents - range_documents.data()) * range_size;
+        const int last_ordinal = std::min(first_ordinal + range_size, ordinal_count);
+        if (first_ordinal < last_ordinal)
+        {
+            ScoreDocuments(terms, first_ordinal, last_ordinal, document_predicate, documents);
+        } });
+
+    std::vector<size_t> offsets(range_count + 1, 0);
+    for (int range = 0; range < range_count; ++range)
     {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+        offsets[range + 1] = offsets[range] + range_documents[range].size();
     }
+    std::vector<Document> matched_documents(offsets.back());
+    std::for_each(par_police, range_documents.begin(), range_documents.end(), [&](const std::vector<Document> &documents)
+                  {
+        const size_t range = &documents - range_documents.data();
+        std::copy(documents.begin(), documents.end(), matched_documents.begin() + offsets[range]); });
     return matched_documents;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy par_police, const Query &query, DocumentPredicate document_predicate) const
-
+void SearchServer::ScoreDocuments(const QueryTerms &terms, int first_ordinal, int last_ordinal, DocumentPredicate &document_predicate, std::vector<Document> &matched_documents) const
 {
-    ConcurrentMap<int, double> document_to_relevance(101);
+    constexpr bool is_status_predicate = std::is_same_v<DocumentPredicate, DocumentStatusPredicate>;
+    const auto accumulator = ScoreAccumulator::Acquire(first_ordinal, last_ordinal - first_ordinal);
 
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [this, &document_to_relevance, &document_predicate](std::string_view word)
-                  {
-        if (word_to_document_freqs_.count(word) != 0)
+    // при параллельном поиске этапы замеряются для каждого диапазона номеров отдельно
+    {
+        QUERY_STAGE(QueryStage::MINUS_FILTERING);
+        for (const PostingList *postings : terms.minus_postings)
         {
-            auto it = word_to_document_freqs_.find(word);
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : it->second)
-            {
-                const auto &document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating))
-                {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
-            }
+            postings->ForEachInRange(first_ordinal, last_ordinal, [&accumulator](const Posting &posting)
+                                     { accumulator->Exclude(posting.ordinal); });
         }
-    });
+    }
 
-    std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](std::string_view word)
-                  {
-        if (word_to_document_freqs_.count(word) != 0)
+    {
+        QUERY_STAGE(QueryStage::POSTING_TRAVERSAL);
+        [[maybe_unused]] uint64_t visited_postings = 0;
+        [[maybe_unused]] uint64_t predicate_rejections = 0;
+        for (const auto &[postings, inverse_document_freq] : terms.plus_postings)
         {
-            auto it = word_to_document_freqs_.find(word);
-            for (const auto [document_id, _] : it->second)
-            {
-                document_to_relevance.Erase(document_id);
-            }
+            postings->ForEachInRange(first_ordinal, last_ordinal, [&, inverse_document_freq = inverse_document_freq](const Posting &posting)
+                                     {
+                ++visited_postings;
+                if constexpr (is_status_predicate)
+                {
+                    // статус проверяется по битовому множеству до обращения к аккумулятору
+                    if (!attributes_.HasStatus(posting.ordinal, document_predicate.status))
+                    {
+                        ++predicate_rejections;
+                        return;
+                    }
+                }
+                if (accumulator->IsExcluded(posting.ordinal))
+                {
+                    return;
+                }
+                // остальные предикаты вычисляются один раз на документ, при первом касании
+                if (!is_status_predicate && !accumulator->IsTouched(posting.ordinal) && !MatchesPredicate(posting.ordinal, document_predicate))
+                {
+                    ++predicate_rejections;
+                    accumulator->Exclude(posting.ordinal);
+                    return;
+                }
+                accumulator->Add(posting.ordinal, posting.term_freq * inverse_document_freq); });
         }
-    });
+        QUERY_COUNT(QueryCounter::POSTINGS_VISITED, visited_postings);
+        QUERY_COUNT(QueryCounter::PREDICATE_REJECTIONS, predicate_rejections);
+    }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap())
+    QUERY_STAGE(QueryStage::SCORE_COLLECTION);
+    [[maybe_unused]] const size_t first_scored = matched_documents.size();
+    accumulator->ForEachScored([&](int ordinal, double relevance)
+                               {
+        const int document_id = ordinal_to_id_[ordinal];
+        matched_documents.push_back({document_id, relevance, attributes_.GetRating(ordinal)}); });
+    QUERY_COUNT(QueryCounter::CANDIDATES_SCORED, matched_documents.size() - first_scored);
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::MatchesPredicate(int ordinal, DocumentPredicate &document_predicate) const
+{
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusPredicate>)
     {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        return attributes_.HasStatus(ordinal, document_predicate.status);
+    }
+    else
+    {
+        return document_predicate(ordinal_to_id_[ordinal], attributes_.GetStatus(ordinal), attributes_.GetRating(ordinal));
     }
-    return matched_documents;
 }
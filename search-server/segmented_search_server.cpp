@@ -0,0 +1,398 @@
+#include "segmented_search_server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+SegmentedSearchServer::SegmentedSearchServer(const string& stop_words_text, Options options)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), options)
+{
+}
+
+SegmentedSearchServer::SegmentedSearchServer(string_view stop_words_text, Options options)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), options)
+{
+}
+
+SegmentedSearchServer::~SegmentedSearchServer()
+{
+    {
+        lock_guard lock(write_mutex_);
+        is_stopping_ = true;
+    }
+    merge_requested_.notify_all();
+    merge_thread_.join();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings)
+{
+    lock_guard lock(write_mutex_);
+    const auto state = LoadState();
+    if (document_id < 0 || FindSegment(*state, document_id)) {
+        throw invalid_argument("Invalid document_id");
+    }
+
+    write_buffer_.push_back({ document_id, string(document), status, ratings });
+    State new_state = *state;
+    try {
+        new_state.write_segments.push_back(BuildWriteSegment(write_buffer_.size() - 1, write_buffer_.size()));
+    }
+    catch (...) {
+        write_buffer_.pop_back();
+        throw;
+    }
+    ++new_state.document_count;
+    ++new_state.version;
+
+    if (write_buffer_.size() >= options_.write_segment_capacity) {
+        new_state.segments.push_back(BuildWriteSegment(0, write_buffer_.size()));
+        new_state.write_segments.clear();
+        write_segment_sizes_.clear();
+        write_buffer_.clear();
+    }
+    else {
+        // документ уже проверен, поэтому слияния сегментов записи не бросают invalid_argument
+        write_segment_sizes_.push_back(1);
+        while (write_segment_sizes_.size() >= 2 && write_segment_sizes_[write_segment_sizes_.size() - 2] <= write_segment_sizes_.back()) {
+            const size_t size = write_segment_sizes_[write_segment_sizes_.size() - 2] + write_segment_sizes_.back();
+            new_state.write_segments.pop_back();
+            new_state.write_segments.back() = BuildWriteSegment(write_buffer_.size() - size, write_buffer_.size());
+            write_segment_sizes_.pop_back();
+            write_segment_sizes_.back() = size;
+        }
+    }
+    PublishState(move(new_state));
+    merge_requested_.notify_one();
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id)
+{
+    lock_guard lock(write_mutex_);
+    const auto state = LoadState();
+    const Segment* segment = FindSegment(*state, document_id);
+    if (!segment) {
+        return;
+    }
+
+    State new_state = *state;
+    --new_state.document_count;
+    ++new_state.version;
+    const auto write_segment_it = find_if(state->write_segments.begin(), state->write_segments.end(), [segment](const Segment& write_segment) {
+        return &write_segment == segment;
+    });
+    if (write_segment_it != state->write_segments.end()) {
+        // документы сегмента записи удаляются сразу, пересобирается только их сегмент
+        const size_t index = write_segment_it - state->write_segments.begin();
+        const size_t first = accumulate(write_segment_sizes_.begin(), write_segment_sizes_.begin() + index, size_t{ 0 });
+        const auto buffer_first = write_buffer_.begin() + first;
+        write_buffer_.erase(find_if(buffer_first, buffer_first + write_segment_sizes_[index], [document_id](const BufferedDocument& document) {
+            return document.id == document_id;
+        }));
+        if (--write_segment_sizes_[index] == 0) {
+            write_segment_sizes_.erase(write_segment_sizes_.begin() + index);
+            new_state.write_segments.erase(new_state.write_segments.begin() + index);
+        }
+        else {
+            new_state.write_segments[index] = BuildWriteSegment(first, first + write_segment_sizes_[index]);
+        }
+    }
+    else {
+        AddRemovedDocument(new_state.segments[segment - state->segments.data()], document_id);
+    }
+    PublishState(move(new_state));
+    merge_requested_.notify_one();
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query) const
+{
+    return FindTopDocuments(execution::seq, raw_query);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t max_document_count) const
+{
+    return FindTopDocuments(execution::seq, raw_query, status, max_document_count);
+}
+
+SearchServer::MatchResult SegmentedSearchServer::MatchDocument(string_view raw_query, int document_id) const
+{
+    const auto state = LoadState();
+    const Segment* segment = FindSegment(*state, document_id);
+    if (!segment) {
+        throw out_of_range("Invalid document_id");
+    }
+    return segment->index->MatchDocument(raw_query, document_id);
+}
+
+void SegmentedSearchServer::EnableQueryCache(size_t capacity, size_t shard_count)
+{
+    query_cache_ = make_unique<QueryResultCache>(capacity, shard_count);
+}
+
+QueryCacheStats SegmentedSearchServer::GetQueryCacheStats() const
+{
+    return query_cache_ ? query_cache_->GetStats() : QueryCacheStats{};
+}
+
+int SegmentedSearchServer::GetDocumentCount() const
+{
+    return LoadState()->document_count;
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const
+{
+    const auto state = LoadState();
+    return state->segments.size() + state->write_segments.size();
+}
+
+void SegmentedSearchServer::WaitForMerges()
+{
+    unique_lock lock(write_mutex_);
+    merge_finished_.wait(lock, [this] {
+        return !is_merging_ && PickMerge(*LoadState()).empty();
+    });
+}
+
+shared_ptr<const SegmentedSearchServer::State> SegmentedSearchServer::LoadState() const
+{
+    return atomic_load(&state_);
+}
+
+void SegmentedSearchServer::PublishState(State state)
+{
+    atomic_store(&state_, shared_ptr<const State>(make_shared<State>(move(state))));
+}
+
+const SegmentedSearchServer::Segment* SegmentedSearchServer::FindSegment(const State& state, int document_id)
+{
+    const auto contains = [document_id](const Segment& segment) {
+        return segment.index->documents_.count(document_id) > 0 && !IsRemoved(segment, document_id);
+    };
+    const auto write_segment_it = find_if(state.write_segments.begin(), state.write_segments.end(), contains);
+    if (write_segment_it != state.write_segments.end()) {
+        return &*write_segment_it;
+    }
+    const auto it = find_if(state.segments.begin(), state.segments.end(), contains);
+    return it == state.segments.end() ? nullptr : &*it;
+}
+
+SegmentedSearchServer::Segment SegmentedSearchServer::BuildWriteSegment(size_t first, size_t last) const
+{
+    vector<NewDocument> documents;
+    documents.reserve(last - first);
+    for (size_t i = first; i < last; ++i) {
+        const BufferedDocument& document = write_buffer_[i];
+        documents.push_back({ document.id, document.text, document.status, document.ratings });
+    }
+    auto index = make_shared<SearchServer>(stop_words_);
+    index->AddDocuments(documents);
+    return MakeSegment(move(index), {});
+}
+
+SegmentedSearchServer::Segment SegmentedSearchServer::MakeSegment(shared_ptr<const SearchServer> index, vector<int> removed_ids)
+{
+    Segment segment{ move(index), {}, removed_ids.size() };
+    if (!removed_ids.empty()) {
+        segment.removed_levels.push_back(CountRemovedWords(*segment.index, move(removed_ids)));
+    }
+    return segment;
+}
+
+shared_ptr<const SegmentedSearchServer::RemovedDocuments> SegmentedSearchServer::CountRemovedWords(const SearchServer& index, vector<int> removed_ids)
+{
+    auto removed = make_shared<RemovedDocuments>();
+    for (const int document_id : removed_ids) {
+        const auto terms = index.GetDocumentTerms(index.documents_.at(document_id));
+        for (size_t i = 0; i < terms.size; ++i) {
+            ++removed->word_counts[index.terms_.GetTerm(terms.term_ids[i])];
+        }
+    }
+    removed->ids = move(removed_ids);
+    return removed;
+}
+
+void SegmentedSearchServer::AddRemovedDocument(Segment& segment, int document_id)
+{
+    auto& levels = segment.removed_levels;
+    levels.push_back(CountRemovedWords(*segment.index, { document_id }));
+    ++segment.removed_count;
+    while (levels.size() >= 2 && levels[levels.size() - 2]->ids.size() <= levels.back()->ids.size()) {
+        const RemovedDocuments& lhs = *levels[levels.size() - 2];
+        const RemovedDocuments& rhs = *levels.back();
+        auto merged = make_shared<RemovedDocuments>();
+        merged->ids.reserve(lhs.ids.size() + rhs.ids.size());
+        merge(lhs.ids.begin(), lhs.ids.end(), rhs.ids.begin(), rhs.ids.end(), back_inserter(merged->ids));
+        merged->word_counts = lhs.word_counts;
+        for (const auto& [word, count] : rhs.word_counts) {
+            merged->word_counts[word] += count;
+        }
+        levels.pop_back();
+        levels.back() = move(merged);
+    }
+}
+
+bool SegmentedSearchServer::IsRemoved(const Segment& segment, int document_id)
+{
+    return any_of(segment.removed_levels.begin(), segment.removed_levels.end(), [document_id](const auto& level) {
+        return binary_search(level->ids.begin(), level->ids.end(), document_id);
+    });
+}
+
+int SegmentedSearchServer::CountRemovedDocumentsWithWord(const Segment& segment, string_view word)
+{
+    int count = 0;
+    for (const auto& level : segment.removed_levels) {
+        const auto it = level->word_counts.find(word);
+        if (it != level->word_counts.end()) {
+            count += it->second;
+        }
+    }
+    return count;
+}
+
+vector<int> SegmentedSearchServer::GetRemovedIds(const Segment& segment)
+{
+    vector<int> removed_ids;
+    removed_ids.reserve(segment.removed_count);
+    for (const auto& level : segment.removed_levels) {
+        removed_ids.insert(removed_ids.end(), level->ids.begin(), level->ids.end());
+    }
+    sort(removed_ids.begin(), removed_ids.end());
+    return removed_ids;
+}
+
+vector<SegmentedSearchServer::Segment> SegmentedSearchServer::PickMerge(const State& state) const
+{
+    for (const Segment& segment : state.segments) {
+        const size_t document_count = segment.index->GetDocumentCount();
+        if (segment.removed_count > max(1.0, options_.max_removed_share * document_count)) {
+            return { segment };
+        }
+    }
+
+    // уровень сегмента: 0 до merge_factor сегментов записи, дальше растёт в merge_factor раз
+    const auto get_level = [this](const Segment& segment) {
+        size_t level = 0;
+        for (size_t size = options_.write_segment_capacity * options_.merge_factor; size <= static_cast<size_t>(segment.index->GetDocumentCount()); size *= options_.merge_factor) {
+            ++level;
+        }
+        return level;
+    };
+    map<size_t, vector<Segment>> levels;
+    for (const Segment& segment : state.segments) {
+        auto& level_segments = levels[get_level(segment)];
+        level_segments.push_back(segment);
+        if (level_segments.size() == options_.merge_factor) {
+            return level_segments;
+        }
+    }
+    return {};
+}
+
+shared_ptr<const SearchServer> SegmentedSearchServer::MergeSegments(const vector<Segment>& segments) const
+{
+    auto merged_index = make_shared<SearchServer>(stop_words_);
+    map<string_view, double> word_freqs;
+    for (const Segment& segment : segments) {
+        const SearchServer& index = *segment.index;
+        const vector<int> removed_ids = GetRemovedIds(segment);
+        for (const auto& [document_id, document_data] : index.documents_) {
+            if (binary_search(removed_ids.begin(), removed_ids.end(), document_id)) {
+                continue;
+            }
+            const auto terms = index.GetDocumentTerms(document_data);
+            word_freqs.clear();
+            for (size_t i = 0; i < terms.size; ++i) {
+                word_freqs.emplace(index.terms_.GetTerm(terms.term_ids[i]), terms.term_freqs[i]);
+            }
+            merged_index->AddDocumentTerms(document_id, document_data.rating, document_data.status, word_freqs);
+        }
+    }
+    merged_index->CompressIndex();
+    return merged_index;
+}
+
+void SegmentedSearchServer::PublishMerge(const vector<Segment>& merged_segments, shared_ptr<const SearchServer> merged_index)
+{
+    const auto state = LoadState();
+    State new_state;
+    new_state.write_segments = state->write_segments;
+    new_state.document_count = state->document_count;
+    new_state.version = state->version;
+
+    // документы, удалённые во время слияния, удаляются и из нового сегмента
+    vector<int> removed_ids;
+    size_t merged_position = state->segments.size();
+    for (const Segment& segment : state->segments) {
+        const auto merged_it = find_if(merged_segments.begin(), merged_segments.end(), [&segment](const Segment& merged_segment) {
+            return merged_segment.index == segment.index;
+        });
+        if (merged_it == merged_segments.end()) {
+            new_state.segments.push_back(segment);
+            continue;
+        }
+        if (segment.removed_count > merged_it->removed_count) {
+            const vector<int> segment_removed_ids = GetRemovedIds(segment);
+            const vector<int> merged_removed_ids = GetRemovedIds(*merged_it);
+            set_difference(segment_removed_ids.begin(), segment_removed_ids.end(),
+                           merged_removed_ids.begin(), merged_removed_ids.end(),
+                           back_inserter(removed_ids));
+        }
+        if (merged_position == state->segments.size()) {
+            merged_position = new_state.segments.size();
+        }
+    }
+    // id разных сегментов не пересекаются, но идут не по порядку
+    sort(removed_ids.begin(), removed_ids.end());
+    if (merged_index->GetDocumentCount() > 0) {
+        new_state.segments.insert(new_state.segments.begin() + merged_position, MakeSegment(move(merged_index), move(removed_ids)));
+    }
+    PublishState(move(new_state));
+}
+
+void SegmentedSearchServer::RunMerges()
+{
+    unique_lock lock(write_mutex_);
+    while (true) {
+        vector<Segment> merged_segments;
+        merge_requested_.wait(lock, [&] {
+            if (is_stopping_) {
+                return true;
+            }
+            merged_segments = PickMerge(*LoadState());
+            return !merged_segments.empty();
+        });
+        if (is_stopping_) {
+            return;
+        }
+
+        is_merging_ = true;
+        lock.unlock();
+        auto merged_index = MergeSegments(merged_segments);
+        lock.lock();
+        PublishMerge(merged_segments, move(merged_index));
+        is_merging_ = false;
+        merge_finished_.notify_all();
+    }
+}
+
+vector<double> SegmentedSearchServer::ComputeInverseDocumentFreqs(const State& state, const SearchServer::Query& query) const
+{
+    vector<double> inverse_document_freqs;
+    inverse_document_freqs.reserve(query.plus_words.size());
+    for (const string_view word : query.plus_words) {
+        int document_count = 0;
+        const auto count_in_segment = [&document_count, word](const Segment& segment) {
+            document_count += segment.index->CountDocumentsWithWord(word) - CountRemovedDocumentsWithWord(segment, word);
+        };
+        for_each(state.segments.begin(), state.segments.end(), count_in_segment);
+        for_each(state.write_segments.begin(), state.write_segments.end(), count_in_segment);
+        // так же, как в SearchServer, чтобы релевантность совпадала до бита
+        inverse_document_freqs.push_back(document_count > 0 ? log(static_cast<double>(state.document_count)) - log(static_cast<double>(document_count)) : 0.0);
+    }
+    return inverse_document_freqs;
+}
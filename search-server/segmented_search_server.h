@@ -0,0 +1,263 @@
+#pragma once
+
+#include "query_cache.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct SegmentedSearchServerOptions
+{
+    // документов в сегменте записи
+    size_t write_segment_capacity = 128;
+    // сколько сегментов одного уровня сливаются в один
+    size_t merge_factor = 8;
+    // доля удалённых документов, при которой сегмент переписывается
+    double max_removed_share = 0.2;
+};
+
+// Индекс из неизменяемых сегментов, который можно изменять во время поиска.
+// Новые документы попадают в буфер записи, разбитый на сегменты записи
+// убывающих размеров: новый документ становится отдельным сегментом, а два
+// последних сегмента сливаются, пока первый не больше второго, как разряды
+// двоичного счётчика. Так каждый документ переиндексируется O(log ёмкости)
+// раз, а заполненный буфер становится обычным сегментом. Удаление помечает
+// документ в его сегменте, пометки хранятся уровнями по той же схеме. Фоновый поток сливает сегменты одного
+// уровня и переписывает сегменты с большой долей удалённых документов.
+// Запрос берёт текущий набор сегментов целиком и не ждёт писателей, а писатели
+// не ждут запросов. Релевантность совпадает с SearchServer с теми же документами:
+// IDF считается по всем сегментам без учёта удалённых
+class SegmentedSearchServer
+{
+public:
+    using Options = SegmentedSearchServerOptions;
+
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer &stop_words, Options options = Options());
+    explicit SegmentedSearchServer(const std::string &stop_words_text, Options options = Options());
+    explicit SegmentedSearchServer(std::string_view stop_words_text, Options options = Options());
+    ~SegmentedSearchServer();
+
+    SegmentedSearchServer(const SegmentedSearchServer &) = delete;
+    SegmentedSearchServer &operator=(const SegmentedSearchServer &) = delete;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int> &ratings);
+    void RemoveDocument(int document_id);
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    SearchServer::MatchResult MatchDocument(std::string_view raw_query, int document_id) const;
+
+    // Включает кэш результатов FindTopDocuments, как SearchServer::EnableQueryCache.
+    // Результаты устаревают при добавлении и удалении документов, но не при слияниях
+    // сегментов. Включается до начала поиска
+    void EnableQueryCache(size_t capacity, size_t shard_count = 16);
+    // Нули, если кэш не включён
+    QueryCacheStats GetQueryCacheStats() const;
+
+    int GetDocumentCount() const;
+    // Число сегментов, включая сегменты записи
+    size_t GetSegmentCount() const;
+
+    // Ждёт, пока фоновый поток не выполнит все слияния, нужные текущему набору сегментов
+    void WaitForMerges();
+
+private:
+    // Уровень удалённых документов сегмента
+    struct RemovedDocuments
+    {
+        // по возрастанию
+        std::vector<int> ids;
+        // сколько из них содержат слово; ключи указывают в словарь индекса сегмента
+        std::unordered_map<std::string_view, int> word_counts;
+    };
+
+    struct Segment
+    {
+        std::shared_ptr<const SearchServer> index;
+        // Удалённые документы уровнями убывающих размеров: удаление добавляет уровень
+        // из одного документа и сливает два последних уровня, пока первый не больше
+        // второго. Удаление копирует только указатели на уровни, а каждый id
+        // переписывается O(log удалённых) раз
+        std::vector<std::shared_ptr<const RemovedDocuments>> removed_levels;
+        size_t removed_count = 0;
+    };
+
+    // Неизменяемое состояние, которое видят запросы
+    struct State
+    {
+        std::vector<Segment> segments;
+        // сегменты записи в порядке буфера записи
+        std::vector<Segment> write_segments;
+        int document_count = 0;
+        // растёт при каждом изменении документов, слияния его сохраняют
+        uint64_t version = 0;
+    };
+
+    struct BufferedDocument
+    {
+        int id;
+        std::string text;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+
+    const Options options_;
+    const std::vector<std::string> stop_words_;
+    // пустой сервер с теми же стоп-словами для разбора запросов
+    const SearchServer query_parser_;
+
+    // читается и заменяется через std::atomic_load и std::atomic_store
+    std::shared_ptr<const State> state_;
+    std::unique_ptr<QueryResultCache> query_cache_;
+
+    // писатели и публикация результата слияния
+    std::mutex write_mutex_;
+    std::vector<BufferedDocument> write_buffer_;
+    // число документов буфера в каждом сегменте записи
+    std::vector<size_t> write_segment_sizes_;
+
+    std::condition_variable merge_requested_;
+    std::condition_variable merge_finished_;
+    bool is_merging_ = false;
+    bool is_stopping_ = false;
+    std::thread merge_thread_;
+
+    std::shared_ptr<const State> LoadState() const;
+    void PublishState(State state);
+
+    static const Segment *FindSegment(const State &state, int document_id);
+    // Сегмент без удалённых документов из документов буфера [first, last)
+    Segment BuildWriteSegment(size_t first, size_t last) const;
+    // removed_ids по возрастанию
+    static Segment MakeSegment(std::shared_ptr<const SearchServer> index, std::vector<int> removed_ids);
+    static std::shared_ptr<const RemovedDocuments> CountRemovedWords(const SearchServer &index, std::vector<int> removed_ids);
+    static void AddRemovedDocument(Segment &segment, int document_id);
+    static bool IsRemoved(const Segment &segment, int document_id);
+    static int CountRemovedDocumentsWithWord(const Segment &segment, std::string_view word);
+    // Все удалённые документы сегмента по возрастанию id
+    static std::vector<int> GetRemovedIds(const Segment &segment);
+
+    // Сегменты, которые нужно слить, в порядке их следования; пусто, если сливать нечего
+    std::vector<Segment> PickMerge(const State &state) const;
+    std::shared_ptr<const SearchServer> MergeSegments(const std::vector<Segment> &segments) const;
+    void PublishMerge(const std::vector<Segment> &merged_segments, std::shared_ptr<const SearchServer> merged_index);
+    void RunMerges();
+
+    std::vector<double> ComputeInverseDocumentFreqs(const State &state, const SearchServer::Query &query) const;
+
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const State &state, const SearchServer::Query &query,
+                                           DocumentPredicate document_predicate, size_t max_document_count) const;
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer &stop_words, Options options)
+    : options_(options)
+    , stop_words_(std::begin(stop_words), std::end(stop_words))
+    , query_parser_(stop_words_)
+    , state_(std::make_shared<const State>())
+    , merge_thread_([this]
+                    { RunMerges(); })
+{
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+                                                              size_t max_document_count) const
+{
+    return FindTopDocuments(policy, raw_query, SearchServer::DocumentStatusPredicate{status}, max_document_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                              size_t max_document_count) const
+{
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_document_count);
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                              size_t max_document_count) const
+{
+    const auto query = query_parser_.ParseQuery(raw_query, true);
+    const auto state = LoadState();
+    const uint64_t predicate_id = SearchServer::GetPredicateId(document_predicate);
+    if (!query_cache_ || predicate_id == 0)
+    {
+        return FindTopDocuments(policy, *state, query, document_predicate, max_document_count);
+    }
+    std::string key = SearchServer::MakeQueryCacheKey(query, predicate_id, max_document_count);
+    if (auto documents = query_cache_->Find(key, state->version))
+    {
+        return std::move(*documents);
+    }
+    auto documents = FindTopDocuments(policy, *state, query, document_predicate, max_document_count);
+    query_cache_->Insert(std::move(key), state->version, documents);
+    return documents;
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy policy, const State &state, const SearchServer::Query &query,
+                                                              DocumentPredicate document_predicate, size_t max_document_count) const
+{
+    const auto inverse_document_freqs = ComputeInverseDocumentFreqs(state, query);
+
+    std::vector<Document> matched_documents;
+    const auto find_in_segment = [&](const Segment &segment)
+    {
+        // предикат передаётся сегменту как есть, чтобы у предиката статуса остался
+        // быстрый путь по битовым множествам; удалённые документы отсеиваются после
+        const auto terms = segment.index->LookupQueryTerms(query, inverse_document_freqs);
+        auto segment_documents = segment.index->FindAllDocuments(policy, terms, document_predicate);
+        if (segment.removed_count > 0)
+        {
+            segment_documents.erase(std::remove_if(segment_documents.begin(), segment_documents.end(), [&segment](const Document &document)
+                                                   { return IsRemoved(segment, document.id); }),
+                                    segment_documents.end());
+        }
+        matched_documents.insert(matched_documents.end(), segment_documents.begin(), segment_documents.end());
+    };
+    for (const Segment &segment : state.segments)
+    {
+        find_in_segment(segment);
+    }
+    for (const Segment &segment : state.write_segments)
+    {
+        find_in_segment(segment);
+    }
+
+    SelectTopDocuments(policy, matched_documents, max_document_count);
+    return matched_documents;
+}
@@ -0,0 +1,43 @@
+#include "stop_word_set.h"
+
+using namespace std;
+
+StopWordSet::StopWordSet(const set<string, less<>>& words)
+{
+    size_t char_count = 0;
+    for (const string& word : words) {
+        char_count += word.size();
+    }
+    // слова ссылаются в chars_, поэтому память выделяется один раз
+    chars_.reserve(char_count);
+    words_.reserve(words.size());
+    for (const string& word : words) {
+        const size_t offset = chars_.size();
+        chars_.insert(chars_.end(), word.begin(), word.end());
+        words_.emplace_back(chars_.data() + offset, word.size());
+    }
+
+    slots_.resize(GetStopWordSlotCount(words_.size()));
+    FillStopWordSlots(words_.data(), words_.size(), slots_.data(), slots_.size());
+    view_ = { words_.data(), words_.size(), slots_.data(), slots_.size(), GetStopWordLengthMask(words_.data(), words_.size()) };
+}
+
+StopWordSet::StopWordSet(const View& view)
+    : view_(view)
+{
+}
+
+size_t StopWordSet::size() const
+{
+    return view_.word_count;
+}
+
+const string_view* StopWordSet::begin() const
+{
+    return view_.words;
+}
+
+const string_view* StopWordSet::end() const
+{
+    return view_.words + view_.word_count;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Хеш стоп-слова, одинаковый во время компиляции и выполнения (FNV-1a)
+constexpr uint32_t HashStopWord(std::string_view word)
+{
+    uint32_t hash = 2166136261u;
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+struct StopWordSlot {
+    uint32_t hash;
+    // номер слова + 1, 0 - пустая ячейка
+    uint32_t word;
+};
+
+// Множество стоп-слов - таблица с открытой адресацией, заполненная не больше чем
+// наполовину. Слово сначала проверяется по маске длин стоп-слов, затем
+// сравниваются хеши, и только при их совпадении - сами строки
+class StopWordSet {
+public:
+    struct View {
+        // слова по возрастанию
+        const std::string_view* words;
+        size_t word_count;
+        // число ячеек - степень двойки
+        const StopWordSlot* slots;
+        size_t slot_count;
+        // бит i - есть стоп-слово длины i, бит 63 - длины от 63
+        uint64_t length_mask;
+    };
+
+    StopWordSet() = default;
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+    // Данные не копируются и должны жить, пока используется множество
+    explicit StopWordSet(const View& view);
+
+    StopWordSet(const StopWordSet&) = delete;
+    StopWordSet& operator=(const StopWordSet&) = delete;
+    StopWordSet(StopWordSet&&) = default;
+    StopWordSet& operator=(StopWordSet&&) = default;
+
+    bool Contains(std::string_view word) const;
+
+    size_t size() const;
+    const std::string_view* begin() const;
+    const std::string_view* end() const;
+
+private:
+    std::vector<char> chars_;
+    std::vector<std::string_view> words_;
+    std::vector<StopWordSlot> slots_;
+    View view_{};
+};
+
+constexpr size_t GetStopWordSlotCount(size_t word_count)
+{
+    size_t slot_count = 1;
+    while (slot_count < word_count * 2) {
+        slot_count *= 2;
+    }
+    return slot_count;
+}
+
+constexpr uint64_t GetStopWordLengthMask(const std::string_view* words, size_t word_count)
+{
+    uint64_t length_mask = 0;
+    for (size_t i = 0; i < word_count; ++i) {
+        length_mask |= uint64_t{ 1 } << (words[i].size() < 63 ? words[i].size() : 63);
+    }
+    return length_mask;
+}
+
+// slots должен состоять из GetStopWordSlotCount(word_count) пустых ячеек
+constexpr void FillStopWordSlots(const std::string_view* words, size_t word_count, StopWordSlot* slots, size_t slot_count)
+{
+    for (size_t i = 0; i < word_count; ++i) {
+        const uint32_t hash = HashStopWord(words[i]);
+        size_t slot = hash & (slot_count - 1);
+        while (slots[slot].word != 0) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = { hash, static_cast<uint32_t>(i + 1) };
+    }
+}
+
+constexpr bool ContainsStopWord(const StopWordSet::View& view, std::string_view word)
+{
+    if ((view.length_mask >> (word.size() < 63 ? word.size() : 63) & 1) == 0) {
+        return false;
+    }
+    const uint32_t hash = HashStopWord(word);
+    for (size_t slot = hash & (view.slot_count - 1); view.slots[slot].word != 0; slot = (slot + 1) & (view.slot_count - 1)) {
+        if (view.slots[slot].hash == hash && view.words[view.slots[slot].word - 1] == word) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool StopWordSet::Contains(std::string_view word) const
+{
+    return ContainsStopWord(view_, word);
+}
+
+template <size_t N>
+constexpr std::array<std::string_view, N> SortStopWords(const std::string_view (&words)[N])
+{
+    std::array<std::string_view, N> sorted_words{};
+    for (size_t i = 0; i < N; ++i) {
+        size_t j = i;
+        for (; j > 0 && words[i] < sorted_words[j - 1]; --j) {
+            sorted_words[j] = sorted_words[j - 1];
+        }
+        sorted_words[j] = words[i];
+    }
+    return sorted_words;
+}
+
+template <size_t N>
+constexpr bool AreStopWordsUnique(const std::array<std::string_view, N>& sorted_words)
+{
+    for (size_t i = 0; i < N; ++i) {
+        if (sorted_words[i].empty() || (i > 0 && sorted_words[i] == sorted_words[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <size_t SlotCount, size_t N>
+constexpr std::array<StopWordSlot, SlotCount> BuildStopWordSlots(const std::array<std::string_view, N>& sorted_words)
+{
+    std::array<StopWordSlot, SlotCount> slots{};
+    FillStopWordSlots(sorted_words.data(), N, slots.data(), SlotCount);
+    return slots;
+}
+
+// Стоп-слова, известные во время компиляции. List - тип со статическим массивом
+// constexpr std::string_view words из различных непустых слов:
+//     struct EnglishStopWords {
+//         static constexpr std::string_view words[] = { "a"sv, "and"sv, "the"sv };
+//     };
+//     static_assert(StaticStopWords<EnglishStopWords>::Contains("the"sv));
+//     SearchServer search_server(StaticStopWords<EnglishStopWords>::GetSet());
+// Таблица строится компилятором, GetSet ссылается на неё без копирования
+template <typename List>
+class StaticStopWords {
+    static constexpr size_t word_count_ = std::size(List::words);
+    static constexpr size_t slot_count_ = GetStopWordSlotCount(word_count_);
+    static constexpr std::array<std::string_view, word_count_> words_ = SortStopWords(List::words);
+    static_assert(AreStopWordsUnique(words_), "Stop words must be unique and non-empty");
+    static constexpr std::array<StopWordSlot, slot_count_> slots_ = BuildStopWordSlots<slot_count_>(words_);
+    static constexpr StopWordSet::View view_ = {
+        words_.data(), word_count_, slots_.data(), slot_count_, GetStopWordLengthMask(words_.data(), word_count_)
+    };
+
+public:
+    static constexpr bool Contains(std::string_view word)
+    {
+        return ContainsStopWord(view_, word);
+    }
+
+    static StopWordSet GetSet()
+    {
+        return StopWordSet(view_);
+    }
+};
@@ -1,31 +1,146 @@
 #include "string_processing.h"
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <string_view>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SEARCH_SERVER_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
-list<string_view> SplitIntoWords(string_view text) {
-    list<string_view> words;
-    
-    int i = 0;
-    int len = 0;
-    for_each(text.begin(), text.end(), [&](const char& c) {
-        if (c == ' ') {
-            if (len) {
-                words.push_back(text.substr(i, len));
-                i += len;
-                len = 0;
-            }
-            ++i;
-        } else {
-            ++len;
+namespace {
+
+size_t CountTrailingZeros(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#else
+    size_t count = 0;
+    for (; (mask & 1) == 0; mask >>= 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Биты [0, end)
+uint64_t LowBits(size_t end) {
+    return end >= 64 ? ~uint64_t{0} : (uint64_t{1} << end) - 1;
+}
+
+// Маски пробелов и управляющих символов (0..31) для 64 символов block
+void ScanBlock(const char* block, uint64_t& space_mask, uint64_t& control_mask) {
+#if defined(__AVX2__)
+    const __m256i spaces = _mm256_set1_epi8(' ');
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+    space_mask = 0;
+    control_mask = 0;
+    for (size_t i = 0; i < 64; i += 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        const __m256i controls = _mm256_and_si256(_mm256_cmpgt_epi8(chars, minus_one), _mm256_cmpgt_epi8(spaces, chars));
+        space_mask |= uint64_t{ static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, spaces))) } << i;
+        control_mask |= uint64_t{ static_cast<uint32_t>(_mm256_movemask_epi8(controls)) } << i;
+    }
+#elif defined(SEARCH_SERVER_SSE2)
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    space_mask = 0;
+    control_mask = 0;
+    for (size_t i = 0; i < 64; i += 16) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        // сравнение знаковое: символы от 128 не считаются управляющими
+        const __m128i controls = _mm_and_si128(_mm_cmpgt_epi8(chars, minus_one), _mm_cmplt_epi8(chars, spaces));
+        space_mask |= uint64_t{ static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, spaces))) } << i;
+        control_mask |= uint64_t{ static_cast<uint16_t>(_mm_movemask_epi8(controls)) } << i;
+    }
+#else
+    space_mask = 0;
+    control_mask = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        const unsigned char c = static_cast<unsigned char>(block[i]);
+        space_mask |= uint64_t{ c == ' ' } << i;
+        control_mask |= uint64_t{ c < ' ' } << i;
+    }
+#endif
+}
+
+} // namespace
+
+WordTokenizer::WordTokenizer(string_view text)
+    : text_(text)
+{
+    LoadBlock(0);
+}
+
+bool WordTokenizer::LoadBlock(size_t block_start) {
+    block_start_ = block_start;
+    word_mask_ = 0;
+    control_mask_ = 0;
+    if (block_start >= text_.size()) {
+        return false;
+    }
+
+    uint64_t space_mask;
+    const size_t size = min(block_size, text_.size() - block_start);
+    if (size == block_size) {
+        ScanBlock(text_.data() + block_start, space_mask, control_mask_);
+    }
+    else {
+        // неполный последний блок дополняется пробелами
+        char block[block_size];
+        memset(block, ' ', block_size);
+        memcpy(block, text_.data() + block_start, size);
+        ScanBlock(block, space_mask, control_mask_);
+    }
+    word_mask_ = ~space_mask;
+    return true;
+}
+
+bool WordTokenizer::Next(Token& token) {
+    while (word_mask_ == 0) {
+        if (!LoadBlock(block_start_ + block_size)) {
+            return false;
         }
-    });
-    
-    if (len) {
-        words.push_back(text.substr(i, len));
     }
-    
+
+    size_t offset = CountTrailingZeros(word_mask_);
+    const size_t begin = block_start_ + offset;
+    bool is_valid = true;
+    while (true) {
+        // слово кончается на первом пробеле после offset или на границе блока
+        const uint64_t rest = ~(word_mask_ >> offset);
+        const size_t end = rest == 0 ? block_size : offset + CountTrailingZeros(rest);
+        is_valid = is_valid && (control_mask_ & LowBits(end) & ~LowBits(offset)) == 0;
+        if (end < block_size) {
+            word_mask_ &= ~LowBits(end);
+            token = { text_.substr(begin, block_start_ + end - begin), is_valid };
+            return true;
+        }
+        // слово может продолжаться в следующем блоке
+        if (!LoadBlock(block_start_ + block_size)) {
+            token = { text_.substr(begin), is_valid };
+            return true;
+        }
+        offset = 0;
+    }
+}
+
+size_t SplitIntoWords(string_view text, vector<string_view>& words) {
+    const size_t old_size = words.size();
+    WordTokenizer tokenizer(text);
+    for (Token token; tokenizer.Next(token);) {
+        words.push_back(token.word);
+    }
+    return words.size() - old_size;
+}
+
+vector<string_view> SplitIntoWords(string_view text) {
+    vector<string_view> words;
+    SplitIntoWords(text, words);
     return words;
 }
@@ -1,11 +1,44 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <list>
 #include <set>
 #include <string_view>
 
-std::list<std::string_view> SplitIntoWords(std::string_view text);
+// Слово текста и признак того, что в нём нет управляющих символов
+struct Token {
+    std::string_view word;
+    bool is_valid;
+};
+
+// Ленивый разбор текста на слова, разделённые пробелами. Память не выделяется:
+// слова ссылаются на исходный текст. Текст просматривается блоками по 64 символа
+// (через SSE2/AVX2, если они доступны), и за тот же проход отмечаются
+// управляющие символы
+class WordTokenizer {
+public:
+    explicit WordTokenizer(std::string_view text);
+
+    // false, если слов больше нет
+    bool Next(Token& token);
+
+private:
+    static constexpr size_t block_size = 64;
+
+    std::string_view text_;
+    size_t block_start_ = 0;
+    // бит i - символ block_start_ + i; непробельные символы, которые ещё не выданы
+    uint64_t word_mask_ = 0;
+    uint64_t control_mask_ = 0;
+
+    // false, если текст кончился
+    bool LoadBlock(size_t block_start);
+};
+
+// Дописывает слова text в конец words и возвращает их число
+size_t SplitIntoWords(std::string_view text, std::vector<std::string_view>& words);
+std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
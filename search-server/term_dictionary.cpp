@@ -0,0 +1,86 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+TermDictionary::TermDictionary(const Table& table)
+    : table_(table)
+{
+}
+
+int TermDictionary::Intern(string_view term)
+{
+    const int existing_id = Find(term);
+    if (existing_id >= 0) {
+        return existing_id;
+    }
+    const int term_id = static_cast<int>(size());
+    const string_view stored_term = Store(term);
+    id_to_term_.push_back(stored_term);
+    term_to_id_.emplace(stored_term, term_id);
+    return term_id;
+}
+
+int TermDictionary::Find(string_view term) const
+{
+    const int term_id = FindInTable(term);
+    if (term_id >= 0) {
+        return term_id;
+    }
+    const auto it = term_to_id_.find(term);
+    return it == term_to_id_.end() ? -1 : it->second;
+}
+
+string_view TermDictionary::GetTerm(int term_id) const
+{
+    const size_t id = static_cast<size_t>(term_id);
+    if (id < table_.size) {
+        return { table_.chars + table_.offsets[id], static_cast<size_t>(table_.offsets[id + 1] - table_.offsets[id]) };
+    }
+    return id_to_term_[id - table_.size];
+}
+
+size_t TermDictionary::size() const
+{
+    return table_.size + id_to_term_.size();
+}
+
+size_t TermDictionary::GetMemoryUsage() const
+{
+    // узел unordered_map: ключ, значение и указатель на следующий, плюс корзина
+    const size_t node_size = sizeof(string_view) + sizeof(int) + 2 * sizeof(void*);
+    return arena_size_ + term_to_id_.size() * node_size + term_to_id_.bucket_count() * sizeof(void*)
+        + id_to_term_.capacity() * sizeof(string_view);
+}
+
+int TermDictionary::FindInTable(string_view term) const
+{
+    const uint32_t* sorted_ids_end = table_.sorted_ids + table_.size;
+    const uint32_t* it = lower_bound(table_.sorted_ids, sorted_ids_end, term, [this](uint32_t term_id, string_view term) {
+        return GetTerm(static_cast<int>(term_id)) < term;
+    });
+    return (it != sorted_ids_end && GetTerm(static_cast<int>(*it)) == term) ? static_cast<int>(*it) : -1;
+}
+
+string_view TermDictionary::Store(string_view term)
+{
+    // длинные слова получают собственный кусок, чтобы не тратить остаток текущего
+    if (term.size() > chunk_size_ / 4) {
+        char* data = chunks_.emplace_back(make_unique<char[]>(term.size())).get();
+        memcpy(data, term.data(), term.size());
+        arena_size_ += term.size();
+        return { data, term.size() };
+    }
+    if (term.size() > chunk_left_) {
+        chunk_position_ = chunks_.emplace_back(make_unique<char[]>(chunk_size_)).get();
+        chunk_left_ = chunk_size_;
+        arena_size_ += chunk_size_;
+    }
+    char* data = chunk_position_;
+    memcpy(data, term.data(), term.size());
+    chunk_position_ += term.size();
+    chunk_left_ -= term.size();
+    return { data, term.size() };
+}
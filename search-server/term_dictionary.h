@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Словарь слов индекса. Каждое слово хранится один раз в арене и получает
+// постоянный id; string_view на слова остаются валидными, пока жив словарь,
+// в том числе после удаления всех документов со словом
+class TermDictionary {
+public:
+    // Неизменяемая часть словаря с id 0..size-1, например из снимка индекса.
+    // Слово term_id занимает chars[offsets[term_id], offsets[term_id + 1]),
+    // sorted_ids перечисляет id в алфавитном порядке слов
+    struct Table {
+        const char* chars = nullptr;
+        const uint64_t* offsets = nullptr;
+        const uint32_t* sorted_ids = nullptr;
+        size_t size = 0;
+    };
+
+    TermDictionary() = default;
+    // Не копирует table: данные должны жить дольше словаря
+    explicit TermDictionary(const Table& table);
+
+    // Возвращает id слова, добавляя его при необходимости
+    int Intern(std::string_view term);
+    // id слова или -1, если слова нет
+    int Find(std::string_view term) const;
+    std::string_view GetTerm(int term_id) const;
+
+    size_t size() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr size_t chunk_size_ = 64 * 1024;
+
+    Table table_;
+
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* chunk_position_ = nullptr;
+    size_t chunk_left_ = 0;
+    size_t arena_size_ = 0;
+
+    // слова, добавленные после table_, с id от table_.size
+    std::unordered_map<std::string_view, int> term_to_id_;
+    std::vector<std::string_view> id_to_term_;
+
+    int FindInTable(std::string_view term) const;
+
+    std::string_view Store(std::string_view term);
+};
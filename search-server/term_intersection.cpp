@@ -0,0 +1,95 @@
+#include "term_intersection.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SEARCH_SERVER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+#if defined(__AVX2__)
+constexpr size_t block_size = 8;
+#elif defined(SEARCH_SERVER_SSE2)
+constexpr size_t block_size = 4;
+#else
+constexpr size_t block_size = 1;
+#endif
+
+// Есть ли id среди block_size элементов block
+bool BlockContains(const int* block, int id)
+{
+#if defined(__AVX2__)
+    const __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi32(ids, _mm256_set1_epi32(id))) != 0;
+#elif defined(SEARCH_SERVER_SSE2)
+    const __m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(ids, _mm_set1_epi32(id))) != 0;
+#else
+    return *block == id;
+#endif
+}
+
+// Курсор по document_ids: id запроса идут по возрастанию, поэтому курсор только растёт
+class DocumentCursor {
+public:
+    DocumentCursor(const int* ids, size_t size)
+        : ids_(ids)
+        , size_(size)
+    {
+    }
+
+    bool IsEnd() const
+    {
+        return position_ == size_;
+    }
+
+    bool Contains(int id)
+    {
+        // пропускаем блоки, последний элемент которых меньше id
+        while (position_ + block_size <= size_ && ids_[position_ + block_size - 1] < id) {
+            position_ += block_size;
+        }
+        if (position_ + block_size <= size_) {
+            return BlockContains(ids_ + position_, id);
+        }
+        while (position_ < size_ && ids_[position_] < id) {
+            ++position_;
+        }
+        return position_ < size_ && ids_[position_] == id;
+    }
+
+private:
+    const int* ids_;
+    size_t size_;
+    size_t position_ = 0;
+};
+
+}
+
+size_t IntersectTermIds(const int* query_ids, size_t query_size,
+                        const int* document_ids, size_t document_size, size_t* positions)
+{
+    DocumentCursor cursor(document_ids, document_size);
+    size_t count = 0;
+    for (size_t i = 0; i < query_size && !cursor.IsEnd(); ++i) {
+        if (cursor.Contains(query_ids[i])) {
+            positions[count++] = i;
+        }
+    }
+    return count;
+}
+
+bool HaveCommonTermId(const int* query_ids, size_t query_size, const int* document_ids, size_t document_size)
+{
+    DocumentCursor cursor(document_ids, document_size);
+    for (size_t i = 0; i < query_size && !cursor.IsEnd(); ++i) {
+        if (cursor.Contains(query_ids[i])) {
+            return true;
+        }
+    }
+    return false;
+}
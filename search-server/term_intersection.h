@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+// Ищет элементы query_ids в document_ids и записывает в positions их индексы
+// в query_ids по возрастанию; возвращает их число. Оба массива строго
+// возрастают, positions вмещает query_size элементов. Для каждого элемента
+// запроса document_ids просматривается блоками через SSE2/AVX2, если они доступны;
+// запрос обычно короче документа, и блоки без совпадений пропускаются целиком
+size_t IntersectTermIds(const int* query_ids, size_t query_size,
+                        const int* document_ids, size_t document_size, size_t* positions);
+
+// Есть ли у массивов общий элемент
+bool HaveCommonTermId(const int* query_ids, size_t query_size, const int* document_ids, size_t document_size);
@@ -1 +1,4 @@
-#pragma once
\ No newline at end of file
+#pragma once
+
+// Проверки SearchServer; при ошибке печатают её в cerr и завершают программу
+void TestSearchServer();
@@ -0,0 +1,1382 @@
+#include "test-example_functions.h"
+#include "process_queries.h"
+#include "query_metrics.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "search_cursor.h"
+#include "search_server.h"
+#include "segmented_search_server.h"
+#include "stop_word_set.h"
+#include "string_processing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void AssertImpl(bool value, const string& expr_str, const string& file, const string& func, unsigned line, const string& hint)
+{
+    if (!value) {
+        cerr << file << "("s << line << "): "s << func << ": "s << "ASSERT("s << expr_str << ") failed."s;
+        if (!hint.empty()) {
+            cerr << " Hint: "s << hint;
+        }
+        cerr << endl;
+        abort();
+    }
+}
+
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+template <typename TestFunc>
+void RunTestImpl(TestFunc func, const string& func_name)
+{
+    func();
+    cerr << func_name << " OK"s << endl;
+}
+
+#define RUN_TEST(func) RunTestImpl(func, #func)
+
+// Выдачи совпадают по id и порядку, релевантность - с точностью до ошибок округления
+void AssertSameDocuments(const vector<Document>& expected, const vector<Document>& actual, const string& hint)
+{
+    ASSERT_HINT(expected.size() == actual.size(), hint);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_HINT(expected[i].id == actual[i].id, hint);
+        ASSERT_HINT(expected[i].rating == actual[i].rating, hint);
+        ASSERT_HINT(abs(expected[i].relevance - actual[i].relevance) < 1e-9, hint);
+    }
+}
+
+void AssertSameWordFrequencies(const map<string_view, double>& expected, const map<string_view, double>& actual, const string& hint)
+{
+    ASSERT_HINT(expected.size() == actual.size(), hint);
+    auto actual_it = actual.begin();
+    for (const auto& [word, term_freq] : expected) {
+        ASSERT_HINT(word == actual_it->first, hint);
+        ASSERT_HINT(abs(term_freq - actual_it->second) < 1e-9, hint);
+        ++actual_it;
+    }
+}
+
+// Случайный корпус по небольшому словарю: у частых слов длинные списки.
+// Одинаковое зерно дает одинаковую последовательность документов и запросов
+class RandomCorpus {
+public:
+    explicit RandomCorpus(unsigned seed, int vocabulary_size = 60)
+        : generator_(seed)
+        , vocabulary_size_(vocabulary_size)
+    {
+    }
+
+    int Index(size_t count)
+    {
+        return static_cast<int>(generator_() % count);
+    }
+
+    string Word()
+    {
+        return "w"s + to_string(min(Index(vocabulary_size_), Index(vocabulary_size_)));
+    }
+
+    string Text(int max_word_count = 12)
+    {
+        string text;
+        for (int i = 1 + Index(max_word_count); i > 0; --i) {
+            text += Word() + ' ';
+        }
+        return text;
+    }
+
+    string Query()
+    {
+        string query = Text(4);
+        if (Index(3) == 0) {
+            query += '-' + Word();
+        }
+        return query;
+    }
+
+    DocumentStatus Status()
+    {
+        return static_cast<DocumentStatus>(Index(4));
+    }
+
+    vector<int> Ratings()
+    {
+        return { Index(11) - 5, Index(11) - 5 };
+    }
+
+private:
+    mt19937 generator_;
+    int vocabulary_size_;
+};
+
+// MAX_SCORE отбрасывает документы, которые не могут попасть в выдачу, поэтому
+// сравнивается с полным перебором на случайных корпусах: со статусами и предикатами,
+// после удалений и после сжатия индекса
+void TestMaxScoreMatchesExhaustive()
+{
+    for (const unsigned seed : { 1u, 2u, 3u, 4u, 5u }) {
+        mt19937 generator(seed);
+        const auto random_index = [&generator](size_t count) {
+            return static_cast<int>(generator() % count);
+        };
+        // слов мало, чтобы списки были длиннее блока и оценки по блокам работали
+        const int vocabulary_size = 60;
+        const auto random_word = [&] {
+            // неравномерное распределение: у частых слов длинные списки
+            return "w"s + to_string(min(random_index(vocabulary_size), random_index(vocabulary_size)));
+        };
+
+        SearchServer search_server("w0"s);
+        const int document_count = 3000;
+        for (int id = 0; id < document_count; ++id) {
+            string text;
+            for (int i = 1 + random_index(12); i > 0; --i) {
+                text += random_word() + ' ';
+            }
+            search_server.AddDocument(id, text, static_cast<DocumentStatus>(random_index(4)), { random_index(11) - 5, random_index(11) - 5 });
+        }
+
+        vector<string> queries;
+        for (int i = 0; i < 30; ++i) {
+            string query;
+            for (int j = 1 + random_index(4); j > 0; --j) {
+                query += random_word() + ' ';
+            }
+            if (random_index(3) == 0) {
+                query += '-' + random_word();
+            }
+            queries.push_back(query);
+        }
+
+        const auto check = [&](const string& stage) {
+            const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+                return document_id % 3 != 0 && status != DocumentStatus::BANNED && rating >= 0;
+            };
+            for (const string& query : queries) {
+                for (const size_t top_count : { size_t{ 1 }, size_t{ 3 }, size_t{ 5 }, size_t{ 20 }, size_t{ 200 } }) {
+                    const string hint = stage + ", seed "s + to_string(seed) + ", query \""s + query + "\", K = "s + to_string(top_count);
+                    for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+                        AssertSameDocuments(search_server.FindTopDocuments(RetrievalMode::EXHAUSTIVE, query, status, top_count),
+                                            search_server.FindTopDocuments(RetrievalMode::MAX_SCORE, query, status, top_count), hint);
+                    }
+                    AssertSameDocuments(search_server.FindTopDocuments(RetrievalMode::EXHAUSTIVE, query, predicate, top_count),
+                                        search_server.FindTopDocuments(RetrievalMode::MAX_SCORE, query, predicate, top_count), hint);
+                }
+            }
+        };
+
+        check("after adds"s);
+        // id могут повторяться, повторное удаление ничего не делает
+        for (int i = 0; i < document_count / 10; ++i) {
+            search_server.RemoveDocument(random_index(document_count));
+        }
+        check("after removals"s);
+        search_server.CompressIndex();
+        check("after CompressIndex"s);
+        for (int i = 0; i < document_count / 10; ++i) {
+            search_server.RemoveDocument(random_index(document_count));
+        }
+        check("after removals from compressed index"s);
+    }
+}
+
+// Сжатый индекс хранит те же списки, что и несжатый: два одинаковых корпуса,
+// сжимается только один, выдачи и частоты слов совпадают и после удалений и добавлений
+void TestCompressedIndexMatchesUncompressed()
+{
+    for (const unsigned seed : { 1u, 2u, 3u }) {
+        RandomCorpus corpus(seed);
+        SearchServer plain_server("w0"s);
+        SearchServer compressed_server("w0"s);
+        int next_id = 0;
+        const auto add_documents = [&](int count) {
+            for (int i = 0; i < count; ++i, ++next_id) {
+                const string text = corpus.Text();
+                const DocumentStatus status = corpus.Status();
+                const vector<int> ratings = corpus.Ratings();
+                plain_server.AddDocument(next_id, text, status, ratings);
+                compressed_server.AddDocument(next_id, text, status, ratings);
+            }
+        };
+        const auto remove_documents = [&](int count) {
+            for (int i = 0; i < count; ++i) {
+                const int document_id = corpus.Index(next_id);
+                plain_server.RemoveDocument(document_id);
+                compressed_server.RemoveDocument(document_id);
+            }
+        };
+
+        vector<string> queries;
+        for (int i = 0; i < 30; ++i) {
+            queries.push_back(corpus.Query());
+        }
+
+        const auto check = [&](const string& stage) {
+            const string stage_hint = stage + ", seed "s + to_string(seed);
+            ASSERT_HINT(plain_server.GetDocumentCount() == compressed_server.GetDocumentCount(), stage_hint);
+            for (const string& query : queries) {
+                const string hint = stage_hint + ", query \""s + query + '"';
+                for (const RetrievalMode mode : { RetrievalMode::EXHAUSTIVE, RetrievalMode::MAX_SCORE }) {
+                    for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+                        AssertSameDocuments(plain_server.FindTopDocuments(mode, query, status, 20),
+                                            compressed_server.FindTopDocuments(mode, query, status, 20), hint);
+                    }
+                }
+                AssertSameDocuments(plain_server.FindTopDocuments(execution::par, query),
+                                    compressed_server.FindTopDocuments(execution::par, query), hint);
+            }
+            for (int document_id = 0; document_id < next_id; ++document_id) {
+                AssertSameWordFrequencies(plain_server.GetWordFrequencies(document_id), compressed_server.GetWordFrequencies(document_id),
+                                          stage_hint + ", document "s + to_string(document_id));
+            }
+        };
+
+        add_documents(2000);
+        compressed_server.CompressIndex();
+        check("after CompressIndex"s);
+        remove_documents(200);
+        check("after removals from compressed index"s);
+        // новые документы попадают в несжатую дельту поверх сжатого списка
+        add_documents(500);
+        check("after adds to compressed index"s);
+        compressed_server.CompressIndex();
+        check("after second CompressIndex"s);
+    }
+}
+
+string MakeTemporaryPath(const string& name)
+{
+    return (filesystem::temp_directory_path() / name).string();
+}
+
+vector<string> MakeQueries(RandomCorpus& corpus, int count)
+{
+    vector<string> queries;
+    for (int i = 0; i < count; ++i) {
+        queries.push_back(corpus.Query());
+    }
+    return queries;
+}
+
+// Сохранённый и открытый сервер отвечает так же, как исходный
+void AssertSameServers(const SearchServer& expected, const SearchServer& actual, const vector<string>& queries, const string& hint)
+{
+    ASSERT_HINT(expected.GetDocumentCount() == actual.GetDocumentCount(), hint);
+    ASSERT_HINT(vector<int>(expected.begin(), expected.end()) == vector<int>(actual.begin(), actual.end()), hint);
+    for (const string& query : queries) {
+        const string query_hint = hint + ", query \""s + query + '"';
+        for (const RetrievalMode mode : { RetrievalMode::EXHAUSTIVE, RetrievalMode::MAX_SCORE }) {
+            for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT }) {
+                AssertSameDocuments(expected.FindTopDocuments(mode, query, status, 20), actual.FindTopDocuments(mode, query, status, 20), query_hint);
+            }
+        }
+    }
+    for (const int document_id : expected) {
+        const string document_hint = hint + ", document "s + to_string(document_id);
+        AssertSameWordFrequencies(expected.GetWordFrequencies(document_id), actual.GetWordFrequencies(document_id), document_hint);
+        ASSERT_HINT(expected.MatchDocument(queries.front(), document_id) == actual.MatchDocument(queries.front(), document_id), document_hint);
+    }
+}
+
+// Снимок хранит стоп-слова, сжатые и несжатые списки без удалённых документов;
+// открытый сервер продолжает принимать изменения
+void TestSnapshotRoundTrip()
+{
+    const string path = MakeTemporaryPath("search_server_round_trip.snapshot"s);
+    for (const bool verify_checksum : { false, true }) {
+        RandomCorpus corpus(7);
+        SearchServer server("w0 w1"s);
+        int next_id = 0;
+        const auto add_documents = [&](vector<SearchServer*> servers, int count) {
+            for (int i = 0; i < count; ++i, ++next_id) {
+                const string text = corpus.Text();
+                const DocumentStatus status = corpus.Status();
+                const vector<int> ratings = corpus.Ratings();
+                for (SearchServer* target : servers) {
+                    target->AddDocument(next_id, text, status, ratings);
+                }
+            }
+        };
+        const auto remove_documents = [&](vector<SearchServer*> servers, int count) {
+            for (int i = 0; i < count; ++i) {
+                const int document_id = corpus.Index(next_id);
+                for (SearchServer* target : servers) {
+                    target->RemoveDocument(document_id);
+                }
+            }
+        };
+
+        add_documents({ &server }, 1500);
+        remove_documents({ &server }, 100);
+        server.CompressIndex();
+        add_documents({ &server }, 300);
+        remove_documents({ &server }, 50);
+        server.Save(path);
+
+        SearchServer opened = SearchServer::Open(path, verify_checksum);
+        const vector<string> queries = MakeQueries(corpus, 30);
+        const string hint = "verify_checksum = "s + to_string(verify_checksum);
+        AssertSameServers(server, opened, queries, hint + ", after Open"s);
+        add_documents({ &server, &opened }, 200);
+        remove_documents({ &server, &opened }, 200);
+        AssertSameServers(server, opened, queries, hint + ", after changes"s);
+    }
+    filesystem::remove(path);
+}
+
+// Обрезанный или испорченный снимок не открывается. Без проверки суммы порча
+// содержимого блоков может обнаружиться только при чтении - исключением, а не
+// чтением за границами файла
+void TestCorruptedSnapshotThrows()
+{
+    const string path = MakeTemporaryPath("search_server_corrupted.snapshot"s);
+    RandomCorpus corpus(11);
+    SearchServer server("w0"s);
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id, corpus.Text(), corpus.Status(), corpus.Ratings());
+    }
+    for (int i = 0; i < 20; ++i) {
+        server.RemoveDocument(corpus.Index(100));
+    }
+    server.Save(path);
+    const vector<string> queries = MakeQueries(corpus, 5);
+
+    string original;
+    {
+        ifstream in(path, ios::binary);
+        original.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    const auto write_file = [&path](const string& content) {
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(content.data(), static_cast<streamsize>(content.size()));
+    };
+    const auto opens = [&path](bool verify_checksum) {
+        try {
+            SearchServer::Open(path, verify_checksum);
+            return true;
+        } catch (const runtime_error&) {
+            return false;
+        }
+    };
+
+    for (size_t size = 0; size < original.size(); size += 1 + size / 16) {
+        write_file(original.substr(0, size));
+        const string hint = "truncated to "s + to_string(size) + " bytes"s;
+        ASSERT_HINT(!opens(false), hint);
+        ASSERT_HINT(!opens(true), hint);
+    }
+
+    for (size_t position = 0; position < original.size(); ++position) {
+        string corrupted = original;
+        corrupted[position] ^= 0x5A;
+        write_file(corrupted);
+        const string hint = "byte "s + to_string(position) + " corrupted"s;
+        ASSERT_HINT(!opens(true), hint);
+        try {
+            const SearchServer opened = SearchServer::Open(path, false);
+            for (const string& query : queries) {
+                opened.FindTopDocuments(RetrievalMode::EXHAUSTIVE, query, DocumentStatus::ACTUAL, 5);
+                opened.FindTopDocuments(RetrievalMode::MAX_SCORE, query, DocumentStatus::ACTUAL, 5);
+            }
+            for (const int document_id : opened) {
+                opened.GetWordFrequencies(document_id);
+                opened.MatchDocument(queries.front(), document_id);
+            }
+        } catch (const runtime_error&) {
+        }
+    }
+    filesystem::remove(path);
+}
+
+// Сегментированный сервер отвечает так же, как SearchServer с теми же документами:
+// при сегментах записи, после слияний и после переписывания сегментов,
+// в которых доля удалённых документов превысила max_removed_share
+void TestSegmentedServerMatchesSearchServer()
+{
+    for (const unsigned seed : { 1u, 2u, 3u }) {
+        RandomCorpus corpus(seed);
+        SegmentedSearchServerOptions options;
+        options.write_segment_capacity = 16;
+        options.merge_factor = 3;
+        options.max_removed_share = 0.1;
+        SearchServer server("w0"s);
+        SegmentedSearchServer segmented_server("w0"s, options);
+        segmented_server.EnableQueryCache(64, 4);
+        int next_id = 0;
+        const auto add_documents = [&](int count) {
+            for (int i = 0; i < count; ++i, ++next_id) {
+                const string text = corpus.Text();
+                const DocumentStatus status = corpus.Status();
+                const vector<int> ratings = corpus.Ratings();
+                server.AddDocument(next_id, text, status, ratings);
+                segmented_server.AddDocument(next_id, text, status, ratings);
+            }
+        };
+        // id могут повторяться и указывать на удалённые документы
+        const auto remove_documents = [&](int count) {
+            for (int i = 0; i < count; ++i) {
+                const int document_id = corpus.Index(next_id + 10);
+                server.RemoveDocument(document_id);
+                segmented_server.RemoveDocument(document_id);
+            }
+        };
+        const vector<string> queries = MakeQueries(corpus, 20);
+
+        const auto check = [&](const string& stage) {
+            const string stage_hint = stage + ", seed "s + to_string(seed);
+            ASSERT_HINT(server.GetDocumentCount() == segmented_server.GetDocumentCount(), stage_hint);
+            const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+                return document_id % 3 != 0 && status != DocumentStatus::BANNED && rating >= 0;
+            };
+            for (const string& query : queries) {
+                const string hint = stage_hint + ", query \""s + query + '"';
+                // второй запрос со статусом отвечает из кэша
+                for (int repeat = 0; repeat < 2; ++repeat) {
+                    for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+                        AssertSameDocuments(server.FindTopDocuments(query, status, 20), segmented_server.FindTopDocuments(query, status, 20), hint);
+                    }
+                }
+                AssertSameDocuments(server.FindTopDocuments(query, predicate), segmented_server.FindTopDocuments(query, predicate), hint);
+                AssertSameDocuments(server.FindTopDocuments(execution::par, query), segmented_server.FindTopDocuments(execution::par, query), hint);
+            }
+            for (const int document_id : server) {
+                ASSERT_HINT(server.MatchDocument(queries.front(), document_id) == segmented_server.MatchDocument(queries.front(), document_id),
+                            stage_hint + ", document "s + to_string(document_id));
+            }
+        };
+
+        add_documents(100);
+        check("write segments"s);
+        remove_documents(20);
+        check("removals from write segments"s);
+        add_documents(600);
+        remove_documents(60);
+        check("before merges"s);
+        segmented_server.WaitForMerges();
+        check("after merges"s);
+        // больше max_removed_share документов каждого сегмента, поэтому сегменты переписываются
+        remove_documents(250);
+        check("tombstones before rewrite"s);
+        segmented_server.WaitForMerges();
+        check("after rewrite"s);
+        add_documents(100);
+        segmented_server.WaitForMerges();
+        check("after more adds"s);
+        ASSERT_HINT(segmented_server.GetQueryCacheStats().hits > 0, "seed "s + to_string(seed));
+    }
+}
+
+// Запросы идут во время добавлений, удалений и фоновых слияний: выдача всегда
+// упорядочена и без повторов, а в конце совпадает с SearchServer
+void TestSegmentedServerConcurrentReads()
+{
+    RandomCorpus corpus(5);
+    SegmentedSearchServerOptions options;
+    options.write_segment_capacity = 8;
+    options.merge_factor = 2;
+    SearchServer server("w0"s);
+    SegmentedSearchServer segmented_server("w0"s, options);
+    const vector<string> queries = MakeQueries(corpus, 10);
+
+    atomic_bool is_writing = true;
+    const auto read = [&] {
+        for (size_t i = 0; is_writing || i < queries.size(); ++i) {
+            const string& query = queries[i % queries.size()];
+            const auto documents = i % 2 == 0 ? segmented_server.FindTopDocuments(query) : segmented_server.FindTopDocuments(execution::par, query);
+            ASSERT_HINT(documents.size() <= MAX_RESULT_DOCUMENT_COUNT, query);
+            ASSERT_HINT(is_sorted(documents.begin(), documents.end(), IsMoreRelevant), query);
+            set<int> ids;
+            for (const Document& document : documents) {
+                ASSERT_HINT(ids.insert(document.id).second, query);
+            }
+        }
+    };
+    vector<thread> readers;
+    for (int i = 0; i < 2; ++i) {
+        readers.emplace_back(read);
+    }
+    for (int id = 0; id < 1000; ++id) {
+        const string text = corpus.Text();
+        const DocumentStatus status = corpus.Status();
+        const vector<int> ratings = corpus.Ratings();
+        server.AddDocument(id, text, status, ratings);
+        segmented_server.AddDocument(id, text, status, ratings);
+        if (id % 3 == 0) {
+            const int document_id = corpus.Index(id + 1);
+            server.RemoveDocument(document_id);
+            segmented_server.RemoveDocument(document_id);
+        }
+    }
+    is_writing = false;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+
+    segmented_server.WaitForMerges();
+    ASSERT_HINT(server.GetDocumentCount() == segmented_server.GetDocumentCount(), "after writes"s);
+    for (const string& query : queries) {
+        AssertSameDocuments(server.FindTopDocuments(query), segmented_server.FindTopDocuments(query), "after writes, query \""s + query + '"');
+    }
+}
+
+// Разбор по одному символу: слова разделены пробелами, слово с символом 0..31 недопустимо
+vector<Token> SplitIntoTokensScalar(string_view text)
+{
+    vector<Token> tokens;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        if (text[begin] == ' ') {
+            ++begin;
+            continue;
+        }
+        size_t end = begin;
+        bool is_valid = true;
+        for (; end < text.size() && text[end] != ' '; ++end) {
+            is_valid = is_valid && static_cast<unsigned char>(text[end]) >= ' ';
+        }
+        tokens.push_back({ text.substr(begin, end - begin), is_valid });
+        begin = end;
+    }
+    return tokens;
+}
+
+void AssertSameTokens(string_view text, const string& hint)
+{
+    const vector<Token> expected = SplitIntoTokensScalar(text);
+    WordTokenizer tokenizer(text);
+    size_t count = 0;
+    for (Token token; tokenizer.Next(token); ++count) {
+        ASSERT_HINT(count < expected.size(), hint);
+        // слова ссылаются на исходный текст, а не на копию
+        ASSERT_HINT(token.word.data() == expected[count].word.data(), hint);
+        ASSERT_HINT(token.word.size() == expected[count].word.size(), hint);
+        ASSERT_HINT(token.is_valid == expected[count].is_valid, hint);
+    }
+    ASSERT_HINT(count == expected.size(), hint);
+}
+
+// WordTokenizer сканирует текст векторами по 16 или 32 символа внутри блоков
+// по 64, поэтому сравнивается с разбором по одному символу на границах векторов
+void TestTokenizerMatchesScalar()
+{
+    // слово любой длины с любого смещения, в том числе через границы 16, 32 и 64 символов
+    for (size_t offset = 0; offset < 80; ++offset) {
+        for (size_t length = 1; length < 140; ++length) {
+            const string text = string(offset, ' ') + string(length, 'a') + "  b"s;
+            AssertSameTokens(text, "word at "s + to_string(offset) + ", length "s + to_string(length));
+            AssertSameTokens(string(offset, ' ') + string(length, 'a'), "trailing word at "s + to_string(offset));
+        }
+    }
+    AssertSameTokens(""s, "empty text"s);
+    AssertSameTokens(string(200, ' '), "only spaces"s);
+
+    // управляющий символ в каждой позиции векторов и блоков
+    for (size_t position = 0; position < 130; ++position) {
+        for (const char control : { '\x01', '\t', '\n', '\x1f' }) {
+            string text(140, 'a');
+            text[position] = control;
+            text[135] = ' ';
+            AssertSameTokens(text, "control char at "s + to_string(position));
+
+            SearchServer search_server(""s);
+            bool is_thrown = false;
+            try {
+                search_server.AddDocument(1, text, DocumentStatus::ACTUAL, { 1 });
+            } catch (const invalid_argument&) {
+                is_thrown = true;
+            }
+            ASSERT_HINT(is_thrown, "document with control char at "s + to_string(position));
+        }
+    }
+
+    // случайные тексты из букв, пробелов, управляющих символов и байтов от 128
+    mt19937 generator(17);
+    const string alphabet = "ab   \x01\x1f\x7f\xd0\xff"s;
+    for (int i = 0; i < 2000; ++i) {
+        string text(generator() % 300, ' ');
+        for (char& c : text) {
+            c = alphabet[generator() % alphabet.size()];
+        }
+        AssertSameTokens(text, "random text "s + to_string(i));
+    }
+}
+
+struct TestStopWordList {
+    static constexpr string_view words[] = { "in"sv, "the"sv, "and"sv, "a"sv, "of"sv, "with"sv, "very-long-stop-word-longer-than-sixty-three-characters-to-hit-the-last-length-bit"sv };
+};
+
+static_assert(StaticStopWords<TestStopWordList>::Contains("the"sv));
+static_assert(StaticStopWords<TestStopWordList>::Contains("very-long-stop-word-longer-than-sixty-three-characters-to-hit-the-last-length-bit"sv));
+static_assert(!StaticStopWords<TestStopWordList>::Contains("then"sv));
+static_assert(!StaticStopWords<TestStopWordList>::Contains(""sv));
+
+// StopWordSet и StaticStopWords отвечают так же, как std::set, в том числе для слов,
+// попадающих в одну ячейку таблицы, и для слов с одинаковым хешем
+void TestStopWordSetMatchesSet()
+{
+    const auto check = [](const set<string, less<>>& words, const vector<string>& probes, const string& hint) {
+        const StopWordSet stop_words(words);
+        ASSERT_HINT(stop_words.size() == words.size(), hint);
+        ASSERT_HINT(equal(stop_words.begin(), stop_words.end(), words.begin(), words.end()), hint);
+        for (const string& probe : probes) {
+            ASSERT_HINT(stop_words.Contains(probe) == (words.count(probe) > 0), hint + ", word "s + probe);
+        }
+    };
+
+    vector<string> probes = { ""s, "a"s, "in"s, "the"s, "then"s, "x"s, string(70, 'a'), string(71, 'a') };
+    check({}, probes, "empty set"s);
+    ASSERT_HINT(!StopWordSet().Contains("a"s), "default set"s);
+
+    // слова, у которых совпадают младшие биты хеша, попадают в одну ячейку и ищутся перебором
+    set<string, less<>> same_slot_words;
+    vector<string> same_slot_probes;
+    for (int i = 0; same_slot_probes.size() < 40; ++i) {
+        string word = "w"s + to_string(i);
+        if ((HashStopWord(word) & 63) == 0) {
+            if (same_slot_words.size() < 20) {
+                same_slot_words.insert(word);
+            }
+            same_slot_probes.push_back(move(word));
+        }
+    }
+    check(same_slot_words, same_slot_probes, "same slot"s);
+
+    // два разных слова с одинаковым 32-битным хешем различаются сравнением строк
+    unordered_map<uint32_t, string> word_by_hash;
+    vector<string> colliding_words;
+    for (int i = 0; colliding_words.empty(); ++i) {
+        string word = "c"s + to_string(i);
+        const auto [it, is_inserted] = word_by_hash.emplace(HashStopWord(word), word);
+        if (!is_inserted) {
+            colliding_words = { it->second, word };
+        }
+    }
+    check({ colliding_words[0] }, colliding_words, "hash collision"s);
+    check({ colliding_words[1] }, colliding_words, "hash collision"s);
+
+    set<string, less<>> static_words(begin(TestStopWordList::words), end(TestStopWordList::words));
+    probes.insert(probes.end(), same_slot_probes.begin(), same_slot_probes.end());
+    probes.insert(probes.end(), static_words.begin(), static_words.end());
+    check(static_words, probes, "static words"s);
+    const StopWordSet static_set = StaticStopWords<TestStopWordList>::GetSet();
+    for (const string& probe : probes) {
+        ASSERT_HINT(StaticStopWords<TestStopWordList>::Contains(probe) == (static_words.count(probe) > 0), "static words, word "s + probe);
+        ASSERT_HINT(static_set.Contains(probe) == (static_words.count(probe) > 0), "static set, word "s + probe);
+    }
+}
+
+// Повторный запрос со статусом отвечает из кэша, а любое изменение индекса
+// делает сохранённые результаты устаревшими: выдача совпадает с сервером без кэша
+void TestQueryCacheInvalidation()
+{
+    RandomCorpus corpus(3);
+    SearchServer cached_server("w0"s);
+    SearchServer server("w0"s);
+    cached_server.EnableQueryCache(64, 4);
+    int next_id = 0;
+    const auto add_document = [&] {
+        const string text = corpus.Text();
+        const DocumentStatus status = corpus.Status();
+        const vector<int> ratings = corpus.Ratings();
+        cached_server.AddDocument(next_id, text, status, ratings);
+        server.AddDocument(next_id, text, status, ratings);
+        ++next_id;
+    };
+    for (int i = 0; i < 500; ++i) {
+        add_document();
+    }
+    const string query = "w1 w2 w3 -w4"s;
+
+    // запрос, изменение, тот же запрос: второй раз результат считается заново
+    QueryCacheStats stats = cached_server.GetQueryCacheStats();
+    const auto check = [&](const string& stage) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            AssertSameDocuments(server.FindTopDocuments(query, status), cached_server.FindTopDocuments(query, status), stage);
+        }
+        const QueryCacheStats new_stats = cached_server.GetQueryCacheStats();
+        ASSERT_HINT(new_stats.misses == stats.misses + 2, stage);
+        ASSERT_HINT(new_stats.hits == stats.hits, stage);
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            AssertSameDocuments(server.FindTopDocuments(query, status), cached_server.FindTopDocuments(query, status), stage + ", repeated"s);
+        }
+        ASSERT_HINT(cached_server.GetQueryCacheStats().hits == stats.hits + 2, stage + ", repeated"s);
+        stats = cached_server.GetQueryCacheStats();
+    };
+
+    check("first query"s);
+    ASSERT_HINT(stats.invalidations == 0, "first query"s);
+    // запросы с предикатом-функцией не кэшируются
+    cached_server.FindTopDocuments(query, [](int, DocumentStatus, int) { return true; });
+    ASSERT_HINT(cached_server.GetQueryCacheStats().misses == stats.misses, "predicate"s);
+
+    add_document();
+    check("after AddDocument"s);
+    const string text = corpus.Text();
+    cached_server.AddDocuments({ { next_id, text, DocumentStatus::ACTUAL, { 5 } } });
+    server.AddDocuments({ { next_id, text, DocumentStatus::ACTUAL, { 5 } } });
+    ++next_id;
+    check("after AddDocuments"s);
+    cached_server.RemoveDocument(server.FindTopDocuments(query).front().id);
+    server.RemoveDocument(server.FindTopDocuments(query).front().id);
+    check("after RemoveDocument"s);
+    const vector<int> removed_ids = { 1, 2, 3, 1000 };
+    cached_server.RemoveDocuments(removed_ids);
+    server.RemoveDocuments(removed_ids);
+    check("after RemoveDocuments"s);
+    cached_server.CompressIndex();
+    server.CompressIndex();
+    check("after CompressIndex"s);
+    ASSERT_HINT(stats.invalidations == 10, "invalidations"s);
+}
+
+// Дубликаты - документы с тем же множеством слов без стоп-слов, частоты не важны
+void TestFindExactDuplicates()
+{
+    SearchServer search_server("и"s);
+    search_server.AddDocument(1, "a b c"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "c b a a"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(3, "a b"s, DocumentStatus::BANNED, { 1 });
+    search_server.AddDocument(4, "a и b b b"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(5, "a b c d"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(6, "и"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(7, "и и"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(8, "a b c"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_HINT(FindDuplicates(search_server) == vector<int>({ 2, 4, 7, 8 }), "exact duplicates"s);
+    search_server.CompressIndex();
+    search_server.RemoveDocument(1);
+    ASSERT_HINT(FindDuplicates(search_server) == vector<int>({ 4, 7, 8 }), "after removing the first copy"s);
+}
+
+// При совпадении отпечатков разных множеств слов документы не становятся дубликатами
+void TestFingerprintCollision()
+{
+    const vector<vector<int>> term_ids = { { 1, 2 }, { 3, 4 }, { 1, 2 }, { 3, 4 }, { 1, 2, 3 }, {}, {} };
+    vector<SearchServer::DocumentTerms> terms;
+    for (const vector<int>& ids : term_ids) {
+        terms.push_back({ ids.data(), nullptr, ids.size() });
+    }
+    for (const DocumentFingerprint collision : { DocumentFingerprint{ 0, 0 }, DocumentFingerprint{ 0, 1 } }) {
+        // у всех документов один отпечаток, кроме последнего
+        vector<DocumentFingerprint> fingerprints(terms.size(), DocumentFingerprint{ 0, 0 });
+        fingerprints.back() = collision;
+        vector<char> is_duplicate(terms.size(), false);
+        MarkExactDuplicates(terms, fingerprints, is_duplicate);
+        const bool is_last_duplicate = collision == DocumentFingerprint{ 0, 0 };
+        ASSERT_HINT(is_duplicate == vector<char>({ false, false, true, true, false, false, is_last_duplicate }), "collision"s);
+    }
+    ASSERT_HINT(ComputeDocumentFingerprint(terms[0]) == ComputeDocumentFingerprint(terms[2]), "same terms"s);
+    ASSERT_HINT(!(ComputeDocumentFingerprint(terms[0]) == ComputeDocumentFingerprint(terms[1])), "different terms"s);
+}
+
+// Похожий документ - дубликат, если коэффициент Жаккара не меньше порога,
+// в том числе когда в корзинах много уже найденных дубликатов
+void TestFindNearDuplicates()
+{
+    string common_words;
+    for (int i = 0; i < 19; ++i) {
+        common_words += "c"s + to_string(i) + ' ';
+    }
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, common_words + "x"s, DocumentStatus::ACTUAL, { 1 });
+    // 19 общих слов из 21: коэффициент 19/21
+    search_server.AddDocument(2, common_words + "y"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(3, "p q r s"s, DocumentStatus::ACTUAL, { 1 });
+
+    DuplicateSearchOptions options;
+    options.band_count = 32;
+    options.rows_per_band = 2;
+    options.min_similarity = 19.0 / 21.0;
+    ASSERT_HINT(FindDuplicates(search_server, options) == vector<int>({ 2 }), "similarity at threshold"s);
+    options.min_similarity = nextafter(19.0 / 21.0, 1.0);
+    ASSERT_HINT(FindDuplicates(search_server, options).empty(), "similarity below threshold"s);
+
+    // сотни похожих на первый документов в одних корзинах: каждый находит первый
+    // через цепочку уже отмеченных дубликатов, которых больше max_candidates_per_band
+    options.min_similarity = 0.8;
+    vector<int> expected = { 2 };
+    for (int id = 4; id < 400; ++id) {
+        search_server.AddDocument(id, common_words + "z"s + to_string(id), DocumentStatus::ACTUAL, { 1 });
+        expected.push_back(id);
+    }
+    ASSERT_HINT(FindDuplicates(search_server, options) == expected, "long bucket chains"s);
+}
+
+// RemoveDocuments оставляет сервер в том же состоянии, что и RemoveDocument по
+// каждому id, в том числе для повторяющихся и неизвестных id и сжатого индекса
+void TestRemoveDocumentsMatchesRemoveDocument()
+{
+    for (const bool compress : { false, true }) {
+        RandomCorpus corpus(compress ? 21 : 22);
+        SearchServer one_by_one_server("w0"s);
+        SearchServer batch_server("w0"s);
+        SearchServer par_batch_server("w0"s);
+        vector<SearchServer*> servers = { &one_by_one_server, &batch_server, &par_batch_server };
+        const int document_count = 1500;
+        for (int id = 0; id < document_count; ++id) {
+            const string text = corpus.Text();
+            const DocumentStatus status = corpus.Status();
+            const vector<int> ratings = corpus.Ratings();
+            for (SearchServer* server : servers) {
+                server->AddDocument(id, text, status, ratings);
+            }
+        }
+        const vector<string> queries = MakeQueries(corpus, 20);
+
+        for (int round = 0; round < 3; ++round) {
+            if (compress) {
+                for (SearchServer* server : servers) {
+                    server->CompressIndex();
+                }
+            }
+            // id повторяются, часть id неизвестна серверу
+            vector<int> document_ids;
+            for (int i = 0; i < 200; ++i) {
+                document_ids.push_back(corpus.Index(document_count + 100));
+            }
+            document_ids.push_back(document_ids.front());
+            document_ids.push_back(-1);
+            for (const int document_id : document_ids) {
+                one_by_one_server.RemoveDocument(document_id);
+            }
+            batch_server.RemoveDocuments(document_ids);
+            par_batch_server.RemoveDocuments(execution::par, document_ids);
+
+            const string hint = "compress = "s + to_string(compress) + ", round "s + to_string(round);
+            AssertSameServers(one_by_one_server, batch_server, queries, hint);
+            AssertSameServers(one_by_one_server, par_batch_server, queries, hint + ", par"s);
+            for (int document_id = 0; document_id < document_count; ++document_id) {
+                ASSERT_HINT(batch_server.GetWordFrequencies(document_id).size() == one_by_one_server.GetWordFrequencies(document_id).size(),
+                            hint + ", removed document "s + to_string(document_id));
+            }
+        }
+    }
+}
+
+// Пакетный MatchDocuments возвращает те же слова и статусы, что MatchDocument
+// по каждому документу, в том числе при минус-словах и в сжатом индексе
+void TestMatchDocumentsMatchesMatchDocument()
+{
+    RandomCorpus corpus(31);
+    SearchServer search_server("w0"s);
+    for (int id = 0; id < 1000; ++id) {
+        search_server.AddDocument(id, corpus.Text(), corpus.Status(), corpus.Ratings());
+    }
+    vector<string> queries = MakeQueries(corpus, 30);
+    // частые минус-слова исключают большую часть документов
+    queries.push_back("w1 w2 -w1"s);
+    queries.push_back("w3 w4 w5 -w2 -w6"s);
+    queries.push_back("-w1"s);
+    queries.push_back("w0 unknown"s);
+
+    const auto check = [&queries](const SearchServer& search_server, const string& stage) {
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        for (const string& query : queries) {
+            const string hint = stage + ", query \""s + query + '"';
+            const auto matches = search_server.MatchDocuments(query, document_ids);
+            const auto par_matches = search_server.MatchDocuments(execution::par, query, document_ids);
+            ASSERT_HINT(matches.size() == document_ids.size() && par_matches.size() == document_ids.size(), hint);
+            for (size_t i = 0; i < document_ids.size(); ++i) {
+                const auto expected = search_server.MatchDocument(query, document_ids[i]);
+                ASSERT_HINT(matches[i] == expected, hint + ", document "s + to_string(document_ids[i]));
+                ASSERT_HINT(par_matches[i] == expected, hint + ", document "s + to_string(document_ids[i]));
+            }
+        }
+        bool is_thrown = false;
+        try {
+            search_server.MatchDocuments(queries.front(), { document_ids.front(), -1 });
+        } catch (const out_of_range&) {
+            is_thrown = true;
+        }
+        ASSERT_HINT(is_thrown, stage + ", unknown document"s);
+    };
+
+    check(search_server, "uncompressed"s);
+    for (int i = 0; i < 100; ++i) {
+        search_server.RemoveDocument(corpus.Index(1000));
+    }
+    search_server.CompressIndex();
+    check(search_server, "compressed"s);
+    for (int id = 1000; id < 1100; ++id) {
+        search_server.AddDocument(id, corpus.Text(), corpus.Status(), corpus.Ratings());
+    }
+    check(search_server, "compressed with new documents"s);
+
+    // слова документов открытого снимка читаются из файла
+    const string path = MakeTemporaryPath("search_server_match.snapshot"s);
+    search_server.Save(path);
+    check(SearchServer::Open(path), "opened snapshot"s);
+    filesystem::remove(path);
+}
+
+// FindTopDocumentsBatch отвечает на каждый запрос так же, как FindTopDocuments,
+// а недопустимый запрос приводит к тому же исключению
+void TestFindTopDocumentsBatchMatchesFindTopDocuments()
+{
+    RandomCorpus corpus(41);
+    SearchServer search_server("w0"s);
+    for (int id = 0; id < 3000; ++id) {
+        search_server.AddDocument(id, corpus.Text(), corpus.Status(), corpus.Ratings());
+    }
+    vector<string> queries = MakeQueries(corpus, 40);
+    // пустые запросы, запросы из стоп-слов и неизвестных слов, повторы
+    queries.insert(queries.end(), { ""s, "   "s, "w0"s, "unknown -w1"s, queries.front() });
+
+    for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+        for (const size_t top_count : { size_t{ 0 }, size_t{ 1 }, size_t{ 5 }, size_t{ 100 } }) {
+            const QueryBatchResults results = search_server.FindTopDocumentsBatch(queries, status, top_count);
+            ASSERT_HINT(results.size() == queries.size(), "batch size"s);
+            for (size_t i = 0; i < queries.size(); ++i) {
+                AssertSameDocuments(search_server.FindTopDocuments(queries[i], status, top_count),
+                                    vector<Document>(results[i].begin(), results[i].end()), "query \""s + queries[i] + '"');
+            }
+        }
+    }
+    ASSERT_HINT(search_server.FindTopDocumentsBatch({}).size() == 0, "empty batch"s);
+
+    for (const string& invalid_query : { "w1 --w2"s, "w1 -"s, "w\x01"s }) {
+        vector<string> batch = queries;
+        batch.insert(batch.begin() + 3, invalid_query);
+        bool is_single_thrown = false;
+        try {
+            search_server.FindTopDocuments(invalid_query);
+        } catch (const invalid_argument&) {
+            is_single_thrown = true;
+        }
+        bool is_batch_thrown = false;
+        try {
+            search_server.FindTopDocumentsBatch(batch);
+        } catch (const invalid_argument&) {
+            is_batch_thrown = true;
+        }
+        ASSERT_HINT(is_single_thrown && is_batch_thrown, "invalid query \""s + invalid_query + '"');
+    }
+}
+
+// Ленивый поток выдаёт те же документы в том же порядке, что ProcessQueriesJoined,
+// при любом окне запросов; его можно уничтожить, не дочитав
+void TestLazyJoinedQueriesMatchJoined()
+{
+    RandomCorpus corpus(43);
+    SearchServer search_server("w0"s);
+    for (int id = 0; id < 2000; ++id) {
+        search_server.AddDocument(id, corpus.Text(), corpus.Status(), corpus.Ratings());
+    }
+    vector<string> queries = MakeQueries(corpus, 50);
+    queries.push_back(""s);
+    const vector<Document> expected = ProcessQueriesJoined(search_server, queries);
+
+    for (const size_t max_in_flight : { size_t{ 1 }, size_t{ 2 }, size_t{ 3 }, size_t{ 64 } }) {
+        const string hint = "max_in_flight = "s + to_string(max_in_flight);
+        vector<Document> documents;
+        for (const Document& document : ProcessQueriesJoinedLazy(search_server, queries, max_in_flight)) {
+            documents.push_back(document);
+        }
+        AssertSameDocuments(expected, documents, hint);
+
+        // поток уничтожается, пока рабочие потоки ждут окна
+        for (const size_t read_count : { size_t{ 0 }, size_t{ 1 }, expected.size() / 2 }) {
+            QueryResultStream stream = ProcessQueriesJoinedLazy(search_server, queries, max_in_flight);
+            Document document;
+            for (size_t i = 0; i < read_count; ++i) {
+                ASSERT_HINT(stream.Next(document), hint);
+                ASSERT_HINT(document.id == expected[i].id, hint);
+            }
+        }
+    }
+
+    // исключение недопустимого запроса бросается в его очередь, после него поток продолжается
+    vector<string> batch = { queries[0], "w1 --w2"s, queries[1] };
+    QueryResultStream stream = ProcessQueriesJoinedLazy(search_server, batch, 2);
+    vector<Document> documents;
+    Document document;
+    bool is_thrown = false;
+    while (true) {
+        try {
+            if (!stream.Next(document)) {
+                break;
+            }
+            documents.push_back(document);
+        } catch (const invalid_argument&) {
+            ASSERT_HINT(documents.size() == search_server.FindTopDocuments(queries[0]).size(), "error position"s);
+            is_thrown = true;
+        }
+    }
+    ASSERT_HINT(is_thrown, "invalid query in stream"s);
+    const vector<Document> valid_expected = ProcessQueriesJoined(search_server, { queries[0], queries[1] });
+    AssertSameDocuments(valid_expected, documents, "stream with invalid query"s);
+}
+
+// Счётчики завершившихся потоков сохраняются, хотя их буферы освобождаются
+void TestRequestQueueKeepsExitedThreadCounts()
+{
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    RequestQueue request_queue(search_server);
+    for (int round = 0; round < 10; ++round) {
+        vector<thread> threads;
+        for (int i = 0; i < 5; ++i) {
+            threads.emplace_back([&request_queue] {
+                request_queue.AddFindRequest("cat"s);
+                request_queue.AddFindRequest("dog"s);
+            });
+        }
+        for (thread& thread : threads) {
+            thread.join();
+        }
+        request_queue.AddFindRequest("dog"s);
+    }
+    ASSERT_HINT(request_queue.GetRequestCount() == 110, "requests"s);
+    ASSERT_HINT(request_queue.GetNoResultRequests() == 60, "no result requests"s);
+    ASSERT_HINT(request_queue.GetLatencyHistogram().GetCount() == 110, "latencies"s);
+
+    // поток, переживший очередь, не обращается к ней при завершении
+    thread survivor;
+    atomic_bool is_recorded = false;
+    atomic_bool is_queue_destroyed = false;
+    {
+        RequestQueue short_lived_queue(search_server);
+        survivor = thread([&] {
+            short_lived_queue.AddFindRequest("cat"s);
+            is_recorded = true;
+            while (!is_queue_destroyed) {
+                this_thread::yield();
+            }
+        });
+        while (!is_recorded) {
+            this_thread::yield();
+        }
+    }
+    is_queue_destroyed = true;
+    survivor.join();
+}
+
+// Запросы старше окна не учитываются, и корзина, которую кольцо прошло по кругу,
+// не добавляет счётчики прошлого круга
+void TestRequestQueueSlidingWindow()
+{
+    using namespace chrono;
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    RequestQueueOptions options;
+    options.bucket_width = 200ms;
+    // две корзины: корзина 0 и корзина 2 занимают одно место в кольце
+    options.window = 400ms;
+    const auto start = steady_clock::now();
+    RequestQueue request_queue(search_server, options);
+
+    // корзина 0: [0, 200) мс от создания очереди
+    for (int i = 0; i < 3; ++i) {
+        request_queue.AddFindRequest("dog"s);
+    }
+    request_queue.AddFindRequest("cat"s);
+    ASSERT_HINT(request_queue.GetRequestCount() == 4, "bucket 0"s);
+    ASSERT_HINT(request_queue.GetNoResultRequests() == 3, "bucket 0"s);
+
+    // корзина 2: корзина 0 вышла из окна, хотя её место в кольце ещё не перезаписано
+    this_thread::sleep_until(start + 500ms);
+    ASSERT_HINT(request_queue.GetRequestCount() == 0, "bucket 2 before requests"s);
+    request_queue.AddFindRequest("cat"s);
+    ASSERT_HINT(request_queue.GetRequestCount() == 1, "bucket 2"s);
+    ASSERT_HINT(request_queue.GetNoResultRequests() == 0, "bucket 2"s);
+    ASSERT_HINT(request_queue.GetNoResultRate() == 0.0, "bucket 2"s);
+
+    // корзина 5: окно пусто, а задержки всех запросов остаются в гистограмме
+    this_thread::sleep_until(start + 1100ms);
+    ASSERT_HINT(request_queue.GetRequestCount() == 0, "bucket 5"s);
+    ASSERT_HINT(request_queue.GetLatencyHistogram().GetCount() == 5, "bucket 5"s);
+
+    bool is_thrown = false;
+    try {
+        options.bucket_width = 0ms;
+        RequestQueue invalid_queue(search_server, options);
+    } catch (const invalid_argument&) {
+        is_thrown = true;
+    }
+    ASSERT_HINT(is_thrown, "empty bucket"s);
+}
+
+// Значения на границах корзин: до 32 у каждого значения своя корзина,
+// дальше степень двойки закрывает корзину, а следующее за ней значение открывает новую
+void TestDurationHistogramBuckets()
+{
+    using namespace chrono;
+    vector<uint64_t> values = { 0, 1, 32, 33 };
+    for (int bit = 6; bit < 40; ++bit) {
+        values.push_back(uint64_t{ 1 } << bit);
+        values.push_back((uint64_t{ 1 } << bit) + 1);
+    }
+    const vector<uint64_t> too_large_values = { DurationHistogram::max_value + 5, uint64_t{ 1 } << 50 };
+
+    DurationHistogram empty_histogram;
+    ASSERT_HINT(empty_histogram.GetQuantile(0.5) == 0, "empty"s);
+    ASSERT_HINT(empty_histogram.CountAtOrBelow(DurationHistogram::max_value) == 0, "empty"s);
+
+    DurationHistogram histogram;
+    uint64_t sum = 0;
+    for (const uint64_t value : values) {
+        histogram.Record(value);
+        sum += value;
+    }
+    for (const uint64_t value : too_large_values) {
+        histogram.Record(value);
+        sum += value;
+    }
+    ASSERT_HINT(histogram.GetCount() == values.size() + too_large_values.size(), "count"s);
+    ASSERT_HINT(histogram.GetSum() == sum, "sum"s);
+
+    const auto count_at_or_below = [&values](uint64_t bound) {
+        return static_cast<uint64_t>(count_if(values.begin(), values.end(), [bound](uint64_t value) {
+            return value <= bound;
+        }));
+    };
+    // от 1 до 32 и на степенях двойки счёт точный; 0 делит корзину с 1
+    ASSERT_HINT(histogram.CountAtOrBelow(0) == 0, "bound 0"s);
+    for (uint64_t bound = 1; bound <= 32; ++bound) {
+        ASSERT_HINT(histogram.CountAtOrBelow(bound) == count_at_or_below(bound), "small bound "s + to_string(bound));
+    }
+    for (int bit = 6; bit < 40; ++bit) {
+        const uint64_t bound = uint64_t{ 1 } << bit;
+        ASSERT_HINT(histogram.CountAtOrBelow(bound) == count_at_or_below(bound), "bound 2^"s + to_string(bit));
+        // 2^k + 1 лежит в корзине (2^k, 2^k + 2^(k - 4)] и до её верхней границы не считается
+        ASSERT_HINT(histogram.CountAtOrBelow(bound + 1) == count_at_or_below(bound), "bound 2^"s + to_string(bit) + " + 1"s);
+        ASSERT_HINT(histogram.CountAtOrBelow(bound + (bound >> 4)) == count_at_or_below(bound + 1),
+                    "bucket after 2^"s + to_string(bit));
+    }
+    ASSERT_HINT(histogram.CountAtOrBelow(33) == count_at_or_below(32), "bound 33"s);
+    ASSERT_HINT(histogram.CountAtOrBelow(34) == count_at_or_below(33), "bound 34"s);
+    // значения больше max_value попадают в последнюю корзину и считаются только в общем числе
+    ASSERT_HINT(histogram.CountAtOrBelow(numeric_limits<uint64_t>::max()) == values.size(), "too large"s);
+    ASSERT_HINT(histogram.GetQuantile(1.0) == DurationHistogram::max_value, "quantile 1.0"s);
+    ASSERT_HINT(histogram.GetQuantile(0.0) == 1, "quantile 0.0"s);
+
+    // квантиль - верхняя граница корзины значения
+    for (const uint64_t value : values) {
+        DurationHistogram single;
+        single.Record(value);
+        uint64_t expected = value;
+        if (value == 0) {
+            expected = 1;
+        } else if (value > 32 && (value & (value - 1)) != 0) {
+            expected = (value - 1) + ((value - 1) >> 4);
+        }
+        ASSERT_HINT(single.GetQuantile(0.5) == expected, "quantile of "s + to_string(value));
+        ASSERT_HINT(single.CountAtOrBelow(expected) == 1 && single.CountAtOrBelow(expected - 1) == 0,
+                    "bucket of "s + to_string(value));
+    }
+    for (const uint64_t value : too_large_values) {
+        DurationHistogram single;
+        single.Record(value);
+        ASSERT_HINT(single.GetQuantile(0.5) == DurationHistogram::max_value, "quantile of "s + to_string(value));
+    }
+
+    // строки le в Prometheus совпадают с CountAtOrBelow на степенях двойки от 2^7 до 2^36
+    QueryMetrics& metrics = QueryMetrics::Global();
+    metrics.Reset();
+    const auto start = QueryMetrics::Clock::now();
+    for (const uint64_t value : values) {
+        metrics.RecordStage(QueryStage::TOP_K, start, start + nanoseconds(value));
+    }
+    for (const uint64_t value : too_large_values) {
+        metrics.RecordStage(QueryStage::TOP_K, start, start + nanoseconds(value));
+    }
+    ostringstream output;
+    metrics.WritePrometheus(output);
+    metrics.Reset();
+
+    const string bucket_prefix = "search_server_query_stage_seconds_bucket{stage=\""s
+                                 + string(GetQueryStageName(QueryStage::TOP_K)) + "\",le=\""s;
+    const string count_prefix = "search_server_query_stage_seconds_count{stage=\""s
+                                + string(GetQueryStageName(QueryStage::TOP_K)) + "\"} "s;
+    istringstream input(output.str());
+    int bit = 7;
+    bool has_infinity = false;
+    bool has_count = false;
+    for (string line; getline(input, line);) {
+        if (line.compare(0, count_prefix.size(), count_prefix) == 0) {
+            ASSERT_HINT(stoull(line.substr(count_prefix.size())) == histogram.GetCount(), line);
+            has_count = true;
+            continue;
+        }
+        if (line.compare(0, bucket_prefix.size(), bucket_prefix) != 0) {
+            continue;
+        }
+        const size_t le_end = line.find("\"} "s, bucket_prefix.size());
+        ASSERT_HINT(le_end != string::npos, line);
+        const string le = line.substr(bucket_prefix.size(), le_end - bucket_prefix.size());
+        const uint64_t count = stoull(line.substr(le_end + 3));
+        if (le == "+Inf"s) {
+            ASSERT_HINT(bit == 37 && count == histogram.GetCount(), line);
+            has_infinity = true;
+            continue;
+        }
+        const uint64_t bound = uint64_t{ 1 } << bit;
+        ASSERT_HINT(abs(stod(le) - bound * 1e-9) <= bound * 1e-17, line);
+        ASSERT_HINT(count == count_at_or_below(bound), line);
+        ++bit;
+    }
+    ASSERT_HINT(bit == 37 && has_infinity && has_count, "le lines"s);
+}
+
+// Страницы, склеенные по курсорам, дают полную выдачу без повторов и пропусков,
+// в том числе когда у соседних документов равны и релевантность, и рейтинг
+void TestFindNextPageMatchesFullRanking()
+{
+    RandomCorpus corpus(11);
+    // одинаковые тексты дают одинаковую релевантность, рейтинги из трёх значений часто совпадают
+    vector<string> repeated_texts;
+    for (int i = 0; i < 8; ++i) {
+        repeated_texts.push_back(corpus.Text(6));
+    }
+    SearchServer search_server("w0"s);
+    const int document_count = 1500;
+    for (int id = 0; id < document_count; ++id) {
+        if (id % 2 == 0) {
+            search_server.AddDocument(id, repeated_texts[corpus.Index(repeated_texts.size())], corpus.Status(), { corpus.Index(3) - 1 });
+        } else {
+            search_server.AddDocument(id, corpus.Text(), corpus.Status(), corpus.Ratings());
+        }
+    }
+    vector<string> queries = MakeQueries(corpus, 20);
+    queries.push_back("nothing"s);
+
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return document_id % 3 != 0 && status != DocumentStatus::BANNED && rating >= 0;
+    };
+    size_t tie_count = 0;
+    for (const string& query : queries) {
+        const vector<Document> expected = search_server.FindTopDocuments(RetrievalMode::EXHAUSTIVE, query, DocumentStatus::ACTUAL, document_count);
+        const vector<Document> expected_by_predicate = search_server.FindTopDocuments(RetrievalMode::EXHAUSTIVE, query, predicate, document_count);
+        for (size_t i = 1; i < expected.size(); ++i) {
+            tie_count += expected[i - 1].relevance == expected[i].relevance && expected[i - 1].rating == expected[i].rating;
+        }
+
+        for (const size_t page_size : { size_t{ 1 }, size_t{ 4 }, size_t{ 25 }, size_t{ 1000 } }) {
+            const string hint = "query \""s + query + "\", page size "s + to_string(page_size);
+            // курсор передаётся между страницами строкой, как клиенту
+            const auto read_pages = [&](auto find_page) {
+                vector<Document> documents;
+                SearchCursor cursor;
+                while (true) {
+                    const SearchPage page = find_page(SearchCursor::Parse(cursor.ToString()));
+                    ASSERT_HINT(page.documents.size() <= page_size, hint);
+                    documents.insert(documents.end(), page.documents.begin(), page.documents.end());
+                    if (!page.has_next_page) {
+                        ASSERT_HINT(find_page(page.next_cursor).documents.empty(), hint + ", after the last page"s);
+                        return documents;
+                    }
+                    ASSERT_HINT(page.documents.size() == page_size && page.next_cursor != cursor, hint);
+                    cursor = page.next_cursor;
+                }
+            };
+            AssertSameDocuments(expected, read_pages([&](const SearchCursor& cursor) {
+                return search_server.FindNextPage(query, cursor, page_size);
+            }), hint);
+            AssertSameDocuments(expected, read_pages([&](const SearchCursor& cursor) {
+                return search_server.FindNextPage(execution::par, query, cursor, page_size);
+            }), hint + ", par"s);
+            AssertSameDocuments(expected_by_predicate, read_pages([&](const SearchCursor& cursor) {
+                return search_server.FindNextPage(query, cursor, page_size, predicate);
+            }), hint + ", predicate"s);
+        }
+    }
+    ASSERT_HINT(tie_count > 0, "no ties in the corpus"s);
+}
+
+// Parse восстанавливает курсор из ToString точно, а строки не из ToString отвергает
+void TestSearchCursorRoundTrip()
+{
+    const SearchCursor start;
+    ASSERT_HINT(start.IsStart() && start.ToString().empty(), "start"s);
+    ASSERT_HINT(SearchCursor::Parse(start.ToString()) == start, "start"s);
+
+    SearchServer search_server(""s);
+    search_server.AddDocument(0, "white cat"s, DocumentStatus::ACTUAL, { -7 });
+    search_server.AddDocument(1, "white cat and dog"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 0 });
+    search_server.AddDocument(2147483647, "white dog"s, DocumentStatus::ACTUAL, { -2147483647 });
+    SearchCursor cursor;
+    for (SearchPage page; cursor == start || page.has_next_page;) {
+        page = search_server.FindNextPage("white cat dog"s, cursor, 1);
+        ASSERT_HINT(page.next_cursor != start, "page cursor"s);
+        ASSERT_HINT(SearchCursor::Parse(page.next_cursor.ToString()) == page.next_cursor, page.next_cursor.ToString());
+        cursor = page.next_cursor;
+    }
+
+    // крайние значения полей; ToString не пишет ведущих нулей
+    for (const string& text : { "0:0:0"s, "ffffffffffffffff:ffffffff:7fffffff"s, "3ff0000000000000:80000000:2a"s }) {
+        const SearchCursor parsed = SearchCursor::Parse(text);
+        ASSERT_HINT(parsed.ToString() == text, text);
+        ASSERT_HINT(SearchCursor::Parse(parsed.ToString()) == parsed, text);
+    }
+    ASSERT_HINT(SearchCursor::Parse("00:0:0"s) == SearchCursor::Parse("0:0:0"s), "leading zeros"s);
+    ASSERT_HINT(SearchCursor::Parse("0:0:1"s) != SearchCursor::Parse("0:0:0"s), "id"s);
+
+    const vector<string> malformed_texts = {
+        ":"s, "::"s, "0"s, "0:0"s, "0:0:"s, ":0:0"s, "0::0"s, "0:0:0:"s, "0:0:0:0"s,
+        "g:0:0"s, "0:x:0"s, "A:0:0"s, "-1:0:0"s, " 0:0:0"s, "0:0:0 "s, "0:0:0\0"s, "0\0:0:0"s,
+        // лишняя длина полей
+        "10000000000000000:0:0"s, "00000000000000000:0:0"s, "0:100000000:0"s, "0:0:100000000"s,
+        // отрицательный id
+        "0:0:80000000"s, "0:0:ffffffff"s,
+    };
+    for (const string& text : malformed_texts) {
+        bool is_thrown = false;
+        try {
+            SearchCursor::Parse(text);
+        } catch (const invalid_argument&) {
+            is_thrown = true;
+        }
+        ASSERT_HINT(is_thrown, "cursor \""s + text + '"');
+    }
+}
+
+} // namespace
+
+void TestSearchServer()
+{
+    RUN_TEST(TestMaxScoreMatchesExhaustive);
+    RUN_TEST(TestCompressedIndexMatchesUncompressed);
+    RUN_TEST(TestSnapshotRoundTrip);
+    RUN_TEST(TestCorruptedSnapshotThrows);
+    RUN_TEST(TestSegmentedServerMatchesSearchServer);
+    RUN_TEST(TestSegmentedServerConcurrentReads);
+    RUN_TEST(TestTokenizerMatchesScalar);
+    RUN_TEST(TestStopWordSetMatchesSet);
+    RUN_TEST(TestQueryCacheInvalidation);
+    RUN_TEST(TestFindExactDuplicates);
+    RUN_TEST(TestFingerprintCollision);
+    RUN_TEST(TestFindNearDuplicates);
+    RUN_TEST(TestRemoveDocumentsMatchesRemoveDocument);
+    RUN_TEST(TestMatchDocumentsMatchesMatchDocument);
+    RUN_TEST(TestFindTopDocumentsBatchMatchesFindTopDocuments);
+    RUN_TEST(TestLazyJoinedQueriesMatchJoined);
+    RUN_TEST(TestRequestQueueKeepsExitedThreadCounts);
+    RUN_TEST(TestRequestQueueSlidingWindow);
+    RUN_TEST(TestDurationHistogramBuckets);
+    RUN_TEST(TestFindNextPageMatchesFullRanking);
+    RUN_TEST(TestSearchCursorRoundTrip);
+}
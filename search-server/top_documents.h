@@ -0,0 +1,86 @@
+#pragma once
+
+#include "document.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <execution>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+const double EPSILON = 1e-6;
+
+// Порядок выдачи: релевантность по убыванию, при равной релевантности
+// рейтинг по убыванию, затем id по возрастанию
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs)
+{
+    if (std::abs(lhs.relevance - rhs.relevance) >= EPSILON) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+// Оставляет в documents первые top_count документов в порядке выдачи
+inline void SelectTopDocuments(std::execution::sequenced_policy, std::vector<Document>& documents, size_t top_count)
+{
+    if (documents.size() > top_count) {
+        std::nth_element(documents.begin(), documents.begin() + top_count, documents.end(), IsMoreRelevant);
+        documents.resize(top_count);
+        // ёмкость под все найденные документы не нужна тем, кто хранит выдачу, например пакету запросов
+        documents.shrink_to_fit();
+    }
+    std::sort(documents.begin(), documents.end(), IsMoreRelevant);
+}
+
+// Каждый кусок выбирает свои top_count документов, затем отсортированные
+// победители сливаются попарно по кругу, пока не останется один список
+inline void SelectTopDocuments(std::execution::parallel_policy policy, std::vector<Document>& documents, size_t top_count)
+{
+    constexpr size_t min_chunk_size = 4096;
+    const size_t max_chunk_count = std::max(1u, std::thread::hardware_concurrency()) * 2;
+    const size_t chunk_count = std::min(max_chunk_count, documents.size() / min_chunk_size);
+    if (chunk_count < 2 || top_count == 0) {
+        SelectTopDocuments(std::execution::seq, documents, top_count);
+        return;
+    }
+
+    const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+    std::vector<std::vector<Document>> winners(chunk_count);
+    std::for_each(policy, winners.begin(), winners.end(), [&](std::vector<Document>& chunk_winners) {
+        const size_t chunk = &chunk_winners - winners.data();
+        const auto first = documents.begin() + std::min(documents.size(), chunk * chunk_size);
+        const auto last = documents.begin() + std::min(documents.size(), (chunk + 1) * chunk_size);
+        chunk_winners.assign(std::make_move_iterator(first), std::make_move_iterator(last));
+        SelectTopDocuments(std::execution::seq, chunk_winners, top_count);
+    });
+
+    for (size_t step = 1; step < chunk_count; step *= 2) {
+        std::vector<size_t> pairs;
+        for (size_t left = 0; left + step < chunk_count; left += 2 * step) {
+            pairs.push_back(left);
+        }
+        std::for_each(policy, pairs.begin(), pairs.end(), [&](size_t left) {
+            std::vector<Document>& lhs = winners[left];
+            std::vector<Document>& rhs = winners[left + step];
+            std::vector<Document> merged(std::min(top_count, lhs.size() + rhs.size()));
+            auto lhs_it = lhs.begin();
+            auto rhs_it = rhs.begin();
+            for (Document& document : merged) {
+                if (rhs_it == rhs.end() || (lhs_it != lhs.end() && !IsMoreRelevant(*rhs_it, *lhs_it))) {
+                    document = *lhs_it++;
+                }
+                else {
+                    document = *rhs_it++;
+                }
+            }
+            lhs = std::move(merged);
+            rhs.clear();
+        });
+    }
+    documents = std::move(winners.front());
+}